@@ -0,0 +1,239 @@
+#include "BenchmarkCommon.h"
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <stdexcept>
+#include "JucyBoy/CPU.h"
+
+namespace
+{
+	constexpr uint8_t Low(uint16_t value) { return static_cast<uint8_t>(value & 0xFF); }
+	constexpr uint8_t High(uint16_t value) { return static_cast<uint8_t>(value >> 8); }
+
+	// Minimal helper to hand-assemble a ROM-only cartridge
+	class RomWriter
+	{
+	public:
+		RomWriter() :
+			rom_(2 * Memory::rom_bank_size_, 0x00)
+		{
+			// Entry point: NOP; JP 0x0150
+			SetPosition(0x0100);
+			Emit({ 0x00, 0xC3, 0x50, 0x01 });
+
+			// Cartridge header: ROM only, 2 banks, no external RAM
+			rom_[0x147] = 0x00;
+			rom_[0x148] = 0x00;
+			rom_[0x149] = 0x00;
+
+			SetPosition(0x0150);
+		}
+
+		void SetPosition(uint16_t address) { position_ = address; }
+		uint16_t GetPosition() const { return position_; }
+
+		void Emit(std::initializer_list<uint8_t> bytes)
+		{
+			for (const auto byte : bytes)
+			{
+				rom_.at(position_++) = byte;
+			}
+		}
+
+		// JR / JR cc (opcodes 0x18, 0x20, 0x28, 0x30, 0x38) to an absolute address
+		void EmitRelativeJump(uint8_t opcode, uint16_t target)
+		{
+			const auto displacement = static_cast<int>(target) - static_cast<int>(position_ + 2);
+			if ((displacement < -128) || (displacement > 127)) { throw std::logic_error{ "Relative jump out of range: " + std::to_string(displacement) }; }
+			Emit({ opcode, static_cast<uint8_t>(static_cast<int8_t>(displacement)) });
+		}
+
+		const std::vector<uint8_t>& GetRom() const { return rom_; }
+
+	private:
+		std::vector<uint8_t> rom_;
+		uint16_t position_{ 0 };
+	};
+}
+
+namespace BenchmarkRoms
+{
+	std::vector<uint8_t> MakeCpuLoopRom()
+	{
+		RomWriter rom;
+
+		rom.Emit({ 0xAF });					// XOR A
+		rom.Emit({ 0xE0, 0x40 });			// LDH (LCDC), A
+		rom.Emit({ 0x21, 0x00, 0xC0 });		// LD HL, 0xC000
+		const auto outer_loop = rom.GetPosition();
+		rom.Emit({ 0x06, 0x00 });			// LD B, 0x00
+		const auto inner_loop = rom.GetPosition();
+		rom.Emit({ 0x78 });					// LD A, B
+		rom.Emit({ 0x81 });					// ADD A, C
+		rom.Emit({ 0xA9 });					// XOR C
+		rom.Emit({ 0x4F });					// LD C, A
+		rom.Emit({ 0xCB, 0x11 });			// RL C
+		rom.Emit({ 0xCB, 0x7F });			// BIT 7, A
+		rom.Emit({ 0x77 });					// LD (HL), A
+		rom.Emit({ 0x23 });					// INC HL
+		rom.Emit({ 0x7C });					// LD A, H
+		rom.Emit({ 0xE6, 0xCF });			// AND 0xCF (keep HL inside WRAM)
+		rom.Emit({ 0x67 });					// LD H, A
+		rom.Emit({ 0x86 });					// ADD A, (HL)
+		rom.Emit({ 0x5F });					// LD E, A
+		rom.Emit({ 0x1C });					// INC E
+		rom.Emit({ 0x05 });					// DEC B
+		rom.EmitRelativeJump(0x20, inner_loop);	// JR NZ, inner_loop
+		rom.EmitRelativeJump(0x18, outer_loop);	// JR outer_loop
+
+		return rom.GetRom();
+	}
+
+	std::vector<uint8_t> MakeGameLoopRom()
+	{
+		RomWriter rom;
+		constexpr uint16_t vblank_handler{ 0x0200 };
+
+		rom.Emit({ 0xF3 });					// DI
+		rom.Emit({ 0x31, 0xFE, 0xFF });		// LD SP, 0xFFFE
+		rom.Emit({ 0xAF, 0xE0, 0x40 });		// LCDC = 0x00 (LCD off while initializing VRAM/OAM)
+
+		// Sound: all channels to both outputs, at full volume
+		rom.Emit({ 0x3E, 0x80, 0xE0, 0x26 });	// NR52 = 0x80
+		rom.Emit({ 0x3E, 0x77, 0xE0, 0x24 });	// NR50 = 0x77
+		rom.Emit({ 0x3E, 0xFF, 0xE0, 0x25 });	// NR51 = 0xFF
+		rom.Emit({ 0x3E, 0x80, 0xE0, 0x11 });	// NR11 = 0x80 (50% duty)
+		rom.Emit({ 0x3E, 0xF3, 0xE0, 0x12 });	// NR12 = 0xF3 (decreasing envelope)
+		rom.Emit({ 0x3E, 0x87, 0xE0, 0x14 });	// NR14 = 0x87 (trigger)
+		rom.Emit({ 0x3E, 0x40, 0xE0, 0x16 });	// NR21 = 0x40 (25% duty)
+		rom.Emit({ 0x3E, 0xF0, 0xE0, 0x17 });	// NR22 = 0xF0
+		rom.Emit({ 0x3E, 0x86, 0xE0, 0x19 });	// NR24 = 0x86 (trigger)
+
+		rom.Emit({ 0x21, 0x30, 0xFF });		// LD HL, 0xFF30 (wave RAM)
+		rom.Emit({ 0x06, 0x10 });			// LD B, 16
+		const auto wave_loop = rom.GetPosition();
+		rom.Emit({ 0x78, 0xCB, 0x37, 0xB0 });	// LD A, B; SWAP A; OR B
+		rom.Emit({ 0x22 });					// LD (HL+), A
+		rom.Emit({ 0x05 });					// DEC B
+		rom.EmitRelativeJump(0x20, wave_loop);
+		rom.Emit({ 0x3E, 0x80, 0xE0, 0x1A });	// NR30 = 0x80
+		rom.Emit({ 0x3E, 0x20, 0xE0, 0x1C });	// NR32 = 0x20
+		rom.Emit({ 0x3E, 0x86, 0xE0, 0x1E });	// NR34 = 0x86 (trigger)
+		rom.Emit({ 0x3E, 0xF0, 0xE0, 0x21 });	// NR42 = 0xF0
+		rom.Emit({ 0x3E, 0x45, 0xE0, 0x22 });	// NR43 = 0x45
+		rom.Emit({ 0x3E, 0x80, 0xE0, 0x23 });	// NR44 = 0x80 (trigger)
+
+		// Palettes
+		rom.Emit({ 0x3E, 0xE4, 0xE0, 0x47, 0xE0, 0x48 });	// BGP = OBP0 = 0xE4
+
+		// Tile data (0x8000 - 0x8FFF)
+		rom.Emit({ 0x21, 0x00, 0x80 });		// LD HL, 0x8000
+		const auto tile_data_loop = rom.GetPosition();
+		rom.Emit({ 0x7D, 0xAC, 0x22 });		// LD A, L; XOR H; LD (HL+), A
+		rom.Emit({ 0x7C, 0xFE, 0x90 });		// LD A, H; CP 0x90
+		rom.EmitRelativeJump(0x20, tile_data_loop);
+
+		// Background tile map (0x9800 - 0x9BFF)
+		rom.Emit({ 0x21, 0x00, 0x98 });		// LD HL, 0x9800
+		const auto tile_map_loop = rom.GetPosition();
+		rom.Emit({ 0x7D, 0x22 });			// LD A, L; LD (HL+), A
+		rom.Emit({ 0x7C, 0xFE, 0x9C });		// LD A, H; CP 0x9C
+		rom.EmitRelativeJump(0x20, tile_map_loop);
+
+		// 40 sprites spread over the screen (Y, X, tile, attributes)
+		rom.Emit({ 0x21, 0x00, 0xFE });		// LD HL, 0xFE00
+		rom.Emit({ 0x06, 0x00 });			// LD B, 0
+		const auto oam_loop = rom.GetPosition();
+		rom.Emit({ 0x78, 0x87, 0x87, 0xE6, 0x7F, 0xC6, 0x10, 0x22 });	// LD A, B; ADD A, A; ADD A, A; AND 0x7F; ADD A, 16; LD (HL+), A
+		rom.Emit({ 0x78, 0x87, 0xC6, 0x08, 0x22 });	// LD A, B; ADD A, A; ADD A, 8; LD (HL+), A
+		rom.Emit({ 0x78, 0x22 });			// LD A, B; LD (HL+), A
+		rom.Emit({ 0xAF, 0x22 });			// XOR A; LD (HL+), A
+		rom.Emit({ 0x04, 0x78, 0xFE, 0x28 });	// INC B; LD A, B; CP 40
+		rom.EmitRelativeJump(0x20, oam_loop);
+
+		rom.Emit({ 0x3E, 0x93, 0xE0, 0x40 });	// LCDC = 0x93 (LCD, background and sprites on)
+		rom.Emit({ 0x3E, 0x01, 0xE0, 0xFF });	// IE = VBlank
+		rom.Emit({ 0xFB });					// EI
+
+		const auto main_loop = rom.GetPosition();
+		rom.Emit({ 0x76, 0x00 });			// HALT; NOP
+		rom.Emit({ 0x21, 0x00, 0xC0 });		// LD HL, 0xC000
+		rom.Emit({ 0x06, 0xC8 });			// LD B, 200
+		const auto logic_loop = rom.GetPosition();
+		rom.Emit({ 0x7E, 0x80, 0x22 });		// LD A, (HL); ADD A, B; LD (HL+), A
+		rom.Emit({ 0x05 });					// DEC B
+		rom.EmitRelativeJump(0x20, logic_loop);
+		rom.EmitRelativeJump(0x18, main_loop);
+
+		// VBlank interrupt
+		rom.SetPosition(0x0040);
+		rom.Emit({ 0xC3, Low(vblank_handler), High(vblank_handler) });	// JP vblank_handler
+
+		rom.SetPosition(vblank_handler);
+		rom.Emit({ 0xF5, 0xC5, 0xE5 });		// PUSH AF; PUSH BC; PUSH HL
+		rom.Emit({ 0xF0, 0x43, 0x3C, 0xE0, 0x43, 0x4F });	// SCX += 1; LD C, A
+		rom.Emit({ 0x21, 0x00, 0x88 });		// LD HL, 0x8800
+		rom.Emit({ 0x06, 0x20 });			// LD B, 32
+		const auto tile_update_loop = rom.GetPosition();
+		rom.Emit({ 0x79, 0xA8, 0x22 });		// LD A, C; XOR B; LD (HL+), A
+		rom.Emit({ 0x05 });					// DEC B
+		rom.EmitRelativeJump(0x20, tile_update_loop);
+		rom.Emit({ 0x21, 0x01, 0xFE });		// LD HL, 0xFE01 (X of sprite #0)
+		rom.Emit({ 0x06, 0x28 });			// LD B, 40
+		const auto sprite_update_loop = rom.GetPosition();
+		rom.Emit({ 0x34, 0x2C, 0x2C, 0x2C, 0x2C });	// INC (HL); INC L (x4)
+		rom.Emit({ 0x05 });					// DEC B
+		rom.EmitRelativeJump(0x20, sprite_update_loop);
+		rom.Emit({ 0x79, 0xE0, 0x13 });		// NR13 = SCX
+		rom.Emit({ 0x3E, 0x87, 0xE0, 0x14 });	// NR14 = 0x87 (trigger)
+		rom.Emit({ 0xE1, 0xC1, 0xF1 });		// POP HL; POP BC; POP AF
+		rom.Emit({ 0xD9 });					// RETI
+
+		return rom.GetRom();
+	}
+
+	std::vector<uint8_t> MakeHaltIdleRom()
+	{
+		RomWriter rom;
+
+		rom.Emit({ 0x3E, 0x91, 0xE0, 0x40 });	// LCDC = 0x91 (LCD and background on)
+		rom.Emit({ 0x3E, 0x01, 0xE0, 0xFF });	// IE = VBlank
+		rom.Emit({ 0xFB });					// EI
+		const auto main_loop = rom.GetPosition();
+		rom.Emit({ 0x76, 0x00 });			// HALT; NOP
+		rom.EmitRelativeJump(0x18, main_loop);
+
+		// VBlank interrupt
+		rom.SetPosition(0x0040);
+		rom.Emit({ 0xD9 });					// RETI
+
+		return rom.GetRom();
+	}
+}
+
+TemporaryRomFile::TemporaryRomFile(const std::string &name, const std::vector<uint8_t> &rom) :
+	path_{ (std::filesystem::temp_directory_path() / ("jucyboy_benchmark_" + name + ".gb")).string() }
+{
+	std::ofstream rom_file{ path_, std::ios::binary | std::ios::trunc };
+	rom_file.write(reinterpret_cast<const char*>(rom.data()), rom.size());
+	if (!rom_file) { throw std::runtime_error{ "Could not write temporary ROM file: " + path_ }; }
+}
+
+TemporaryRomFile::~TemporaryRomFile()
+{
+	std::error_code error_code;
+	std::filesystem::remove(path_, error_code);
+}
+
+const char* GetCpuDispatchEngineName()
+{
+#if JUCYBOY_CPU_DISPATCH == JUCYBOY_CPU_DISPATCH_SWITCH
+	return "switch";
+#elif JUCYBOY_CPU_DISPATCH == JUCYBOY_CPU_DISPATCH_TABLE
+	return "table";
+#elif JUCYBOY_CPU_DISPATCH == JUCYBOY_CPU_DISPATCH_THREADED
+	return "threaded";
+#else
+	return "block_cache";
+#endif
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Synthetic ROMs (ROM only, 32 KiB), so that the benchmarks do not depend on any commercial ROM
+namespace BenchmarkRoms
+{
+	// Endless loop mixing the regular opcode blocks (LD r,r', ALU r, INC/DEC r, CB rotations and bit tests), WRAM accesses and conditional branches.
+	// The LCD is turned off, so that the PPU does not hide the CPU cost.
+	std::vector<uint8_t> MakeCpuLoopRom();
+
+	// Typical game frame: background and 40 sprites on screen, all 4 sound channels playing, and a VBlank interrupt handler updating
+	// the scroll, some tiles, the sprites and the sound. The main loop runs some logic in WRAM, then halts until the next VBlank.
+	std::vector<uint8_t> MakeGameLoopRom();
+
+	// The CPU halts all the time, waiting for VBlank interrupts whose handler does nothing
+	std::vector<uint8_t> MakeHaltIdleRom();
+}
+
+// Writes a ROM to a temporary file, which is removed on destruction
+class TemporaryRomFile final
+{
+public:
+	TemporaryRomFile(const std::string &name, const std::vector<uint8_t> &rom);
+	~TemporaryRomFile();
+
+	const std::string& GetPath() const { return path_; }
+
+private:
+	std::string path_;
+
+private:
+	TemporaryRomFile(const TemporaryRomFile&) = delete;
+	TemporaryRomFile& operator=(const TemporaryRomFile&) = delete;
+};
+
+// Name of the CPU dispatch engine selected at build time (see JUCYBOY_CPU_DISPATCH in CPU.h)
+const char* GetCpuDispatchEngineName();
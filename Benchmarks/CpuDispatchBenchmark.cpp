@@ -0,0 +1,31 @@
+// Measures the throughput of the CPU instruction dispatch engine selected at build time (see JUCYBOY_CPU_DISPATCH in CPU.h).
+// Build it once per engine and compare the reported emulated MHz.
+//
+// Usage: CpuDispatchBenchmark [seconds]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include "JucyBoy/JucyBoy.h"
+#include "BenchmarkCommon.h"
+
+int main(int argc, char *argv[])
+{
+	const auto seconds = (argc > 1) ? std::atof(argv[1]) : 3.0;
+
+	const TemporaryRomFile rom_file{ "cpu_dispatch", BenchmarkRoms::MakeCpuLoopRom() };
+	JucyBoy jucy_boy{ rom_file.GetPath() };
+
+	const auto start_time = std::chrono::steady_clock::now();
+	jucy_boy.StartEmulation(false);
+	std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+	jucy_boy.PauseEmulation();
+	const auto elapsed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+	// One machine cycle is 4 clock cycles
+	const auto emulated_clock_cycles = 4.0 * static_cast<double>(jucy_boy.GetScheduler().GetCurrentCycle());
+	std::printf("dispatch=%s seconds=%.3f clock_cycles=%.0f emulated_mhz=%.3f\n", GetCpuDispatchEngineName(), elapsed_seconds, emulated_clock_cycles, emulated_clock_cycles / elapsed_seconds / 1e6);
+
+	return 0;
+}
@@ -0,0 +1,282 @@
+// Throughput benchmark suite, reported as JSON so that results can be compared between commits.
+//
+// Workloads: the bundled synthetic ROMs (see BenchmarkCommon.h) plus any ROM files given in the command line, each run headlessly for a fixed number of frames.
+// The APU output is resampled to 44100 Hz and consumed as AudioPlayerComponent does (minus the audio device).
+// For each one, reports emulated MHz and frames per second, plus the time spent in each component:
+// the emulation is run a second time with Scheduler profiling enabled, and the time not spent synchronizing the Timer/PPU/APU is attributed to the CPU.
+//
+// Microbenchmarks: MMU::ReadByte, PPU::OnVramWritten (with and without tile decoding), the BlipBuffer operations of the APU output stage and snapshots.
+//
+// Usage: ThroughputBenchmark [--frames <n>] [--json <file>] [rom files...]
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "JucyBoy/JucyBoy.h"
+#include "BenchmarkCommon.h"
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double ToSeconds(Clock::duration duration) { return std::chrono::duration<double>(duration).count(); }
+
+	struct WorkloadResult
+	{
+		std::string name;
+		size_t num_frames{ 0 };
+		double seconds{ 0 };
+		double emulated_mhz{ 0 };
+		double cpu_seconds{ 0 };
+		double ppu_seconds{ 0 };
+		double apu_seconds{ 0 };
+		double timer_seconds{ 0 };
+	};
+
+	struct MicrobenchmarkResult
+	{
+		std::string name;
+		double nanoseconds_per_call{ 0 };
+	};
+
+	// Consumes the APU output as AudioPlayerComponent does, so that sample delivery and resampling are part of the measurements
+	class AudioSink final
+	{
+	public:
+		AudioSink(APU &apu)
+		{
+			apu.SetOutputSampleRate(44100);
+			apu.AddOutputListener([this](const APU::OutputSample *, size_t num_output_samples) { num_output_samples_ += num_output_samples; });
+		}
+
+		size_t GetNumOutputSamples() const { return num_output_samples_; }
+
+	private:
+		size_t num_output_samples_{ 0 };
+	};
+
+	WorkloadResult RunWorkload(const std::string &name, const std::string &rom_file_path, size_t num_frames)
+	{
+		// One machine cycle is 4 clock cycles
+		const uint64_t num_machine_cycles = num_frames * (PPU::frame_duration_ / 4);
+
+		WorkloadResult result;
+		result.name = name;
+		result.num_frames = num_frames;
+
+		{
+			JucyBoy jucy_boy{ rom_file_path };
+			AudioSink audio_sink{ jucy_boy.GetApu() };
+			const auto start_time = Clock::now();
+			jucy_boy.RunMachineCycles(num_machine_cycles);
+			result.seconds = ToSeconds(Clock::now() - start_time);
+			result.emulated_mhz = 4.0 * jucy_boy.GetScheduler().GetCurrentCycle() / result.seconds / 1e6;
+		}
+
+		{
+			JucyBoy jucy_boy{ rom_file_path };
+			AudioSink audio_sink{ jucy_boy.GetApu() };
+			auto &scheduler = jucy_boy.GetScheduler();
+			scheduler.SetProfilingEnabled(true);
+			const auto start_time = Clock::now();
+			jucy_boy.RunMachineCycles(num_machine_cycles);
+			const auto total_time = Clock::now() - start_time;
+
+			result.ppu_seconds = ToSeconds(scheduler.GetSynchronizationTime(jucy_boy.GetPpuId()));
+			result.apu_seconds = ToSeconds(scheduler.GetSynchronizationTime(jucy_boy.GetApuId()));
+			result.timer_seconds = ToSeconds(scheduler.GetSynchronizationTime(jucy_boy.GetTimerId()));
+			result.cpu_seconds = ToSeconds(total_time) - result.ppu_seconds - result.apu_seconds - result.timer_seconds;
+		}
+
+		return result;
+	}
+
+	// Calls function(i) with increasing i, in batches, until the minimum duration has elapsed
+	template<class Function>
+	MicrobenchmarkResult RunMicrobenchmark(const std::string &name, Function &&function)
+	{
+		constexpr size_t batch_size{ 1 << 16 };
+		constexpr auto min_duration = std::chrono::milliseconds{ 500 };
+
+		size_t num_calls{ 0 };
+		const auto start_time = Clock::now();
+		auto elapsed_time = Clock::duration{ 0 };
+		do
+		{
+			for (size_t i = 0; i < batch_size; ++i)
+			{
+				function(num_calls + i);
+			}
+			num_calls += batch_size;
+			elapsed_time = Clock::now() - start_time;
+		} while (elapsed_time < min_duration);
+
+		return{ name, ToSeconds(elapsed_time) * 1e9 / num_calls };
+	}
+
+	std::vector<MicrobenchmarkResult> RunMicrobenchmarks()
+	{
+		std::vector<MicrobenchmarkResult> results;
+
+		// Accumulated results are stored here, so that the benchmarked calls are not optimized away
+		volatile size_t sink{ 0 };
+
+		{
+			MMU mmu;
+			size_t sum{ 0 };
+			results.push_back(RunMicrobenchmark("MMU::ReadByte (WRAM, direct page)", [&](size_t i) { sum += mmu.ReadByte(static_cast<Memory::Address>(Memory::wram_offset_ + (i & 0x1FFF))); }));
+			results.push_back(RunMicrobenchmark("MMU::ReadByte (HRAM)", [&](size_t i) { sum += mmu.ReadByte(static_cast<Memory::Address>(Memory::hram_offset_ + (i % Memory::hram_size_))); }));
+			results.push_back(RunMicrobenchmark("MMU::ReadByte (IO register, mapped function)", [&](size_t i) { sum += mmu.ReadByte(static_cast<Memory::Address>(0xFF50 + (i & 0x1F))); }));
+			sink = sum;
+		}
+
+		{
+			MMU mmu;
+			PPU ppu{ mmu };
+			results.push_back(RunMicrobenchmark("PPU::OnVramWritten (tile data)", [&](size_t i) { ppu.OnVramWritten(static_cast<Memory::Address>(Memory::vram_offset_ + (i % 0x1800)), static_cast<uint8_t>(i)); }));
+			results.push_back(RunMicrobenchmark("PPU::OnVramWritten + PPU::GetTileSet (tile data, decoded once per tile)", [&](size_t i)
+			{
+				ppu.OnVramWritten(static_cast<Memory::Address>(Memory::vram_offset_ + (i % 0x1800)), static_cast<uint8_t>(i));
+				if ((i & 0x0F) == 0x0F) sink = sink + ppu.GetTileSet()[(i % 0x1800) >> 4][0];
+			}));
+			sink = sink + ppu.OnVramRead(Memory::vram_offset_);
+		}
+
+		{
+			// One frame per APU sample block, as the APU does
+			BlipBuffer blip_buffer;
+			blip_buffer.SetRates(APU::sample_rate_, 44100, APU::default_sample_block_size_);
+			std::vector<float> samples(APU::default_sample_block_size_);
+			results.push_back(RunMicrobenchmark("BlipBuffer::AddDelta (one delta per APU sample)", [&](size_t i)
+			{
+				const auto clock_time = i % APU::default_sample_block_size_;
+				blip_buffer.AddDelta(clock_time, (i & 0x01) ? 15 : -15);
+				if (clock_time == APU::default_sample_block_size_ - 1)
+				{
+					blip_buffer.EndFrame(APU::default_sample_block_size_);
+					blip_buffer.ReadSamples(samples.data(), blip_buffer.GetNumSamplesAvailable(), 1);
+				}
+			}));
+			results.push_back(RunMicrobenchmark("BlipBuffer::EndFrame + BlipBuffer::ReadSamples (per APU sample block)", [&](size_t)
+			{
+				blip_buffer.EndFrame(APU::default_sample_block_size_);
+				blip_buffer.ReadSamples(samples.data(), blip_buffer.GetNumSamplesAvailable(), 1);
+			}));
+			sink = static_cast<size_t>(samples[0]);
+		}
+
+		{
+			// The game loop ROM, a second into the game
+			const TemporaryRomFile game_loop_rom{ "snapshot_game_loop", BenchmarkRoms::MakeGameLoopRom() };
+			JucyBoy jucy_boy{ game_loop_rom.GetPath() };
+			AudioSink audio_sink{ jucy_boy.GetApu() };
+			jucy_boy.RunMachineCycles(60 * (PPU::frame_duration_ / 4));
+
+			auto snapshot = jucy_boy.CreateSnapshot();
+			results.push_back(RunMicrobenchmark("JucyBoy::SaveSnapshot", [&](size_t) { jucy_boy.SaveSnapshot(snapshot); }));
+			results.push_back(RunMicrobenchmark("JucyBoy::LoadSnapshot", [&](size_t) { jucy_boy.LoadSnapshot(snapshot); }));
+			sink = snapshot.GetSize();
+		}
+
+		return results;
+	}
+
+	std::string EscapeJson(const std::string &text)
+	{
+		std::string escaped;
+		for (const auto c : text)
+		{
+			switch (c)
+			{
+			case '"': escaped += "\\\""; break;
+			case '\\': escaped += "\\\\"; break;
+			case '\n': escaped += "\\n"; break;
+			default: escaped += c; break;
+			}
+		}
+		return escaped;
+	}
+
+	std::string ToJson(const std::vector<WorkloadResult> &workloads, const std::vector<MicrobenchmarkResult> &microbenchmarks)
+	{
+		std::ostringstream json;
+		json.precision(6);
+
+		json << "{\n";
+		json << "  \"cpu_dispatch\": \"" << GetCpuDispatchEngineName() << "\",\n";
+		json << "  \"workloads\": [\n";
+		for (size_t i = 0; i < workloads.size(); ++i)
+		{
+			const auto &workload = workloads[i];
+			json << "    {\"name\": \"" << EscapeJson(workload.name) << "\", \"frames\": " << workload.num_frames
+				<< ", \"seconds\": " << workload.seconds << ", \"fps\": " << (workload.num_frames / workload.seconds) << ", \"emulated_mhz\": " << workload.emulated_mhz
+				<< ", \"component_seconds\": {\"cpu\": " << workload.cpu_seconds << ", \"ppu\": " << workload.ppu_seconds
+				<< ", \"apu\": " << workload.apu_seconds << ", \"timer\": " << workload.timer_seconds << "}}"
+				<< ((i + 1 < workloads.size()) ? ",\n" : "\n");
+		}
+		json << "  ],\n";
+		json << "  \"microbenchmarks\": [\n";
+		for (size_t i = 0; i < microbenchmarks.size(); ++i)
+		{
+			json << "    {\"name\": \"" << EscapeJson(microbenchmarks[i].name) << "\", \"ns_per_call\": " << microbenchmarks[i].nanoseconds_per_call << "}"
+				<< ((i + 1 < microbenchmarks.size()) ? ",\n" : "\n");
+		}
+		json << "  ]\n";
+		json << "}\n";
+
+		return json.str();
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	size_t num_frames{ 600 };
+	std::string json_file_path;
+	std::vector<std::string> rom_file_paths;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string argument{ argv[i] };
+		if ((argument == "--frames") && (i + 1 < argc)) num_frames = std::stoul(argv[++i]);
+		else if ((argument == "--json") && (i + 1 < argc)) json_file_path = argv[++i];
+		else rom_file_paths.push_back(argument);
+	}
+
+	try
+	{
+		std::vector<WorkloadResult> workloads;
+		{
+			const TemporaryRomFile cpu_loop_rom{ "cpu_loop", BenchmarkRoms::MakeCpuLoopRom() };
+			const TemporaryRomFile game_loop_rom{ "game_loop", BenchmarkRoms::MakeGameLoopRom() };
+			const TemporaryRomFile halt_idle_rom{ "halt_idle", BenchmarkRoms::MakeHaltIdleRom() };
+			workloads.push_back(RunWorkload("cpu_loop", cpu_loop_rom.GetPath(), num_frames));
+			workloads.push_back(RunWorkload("game_loop", game_loop_rom.GetPath(), num_frames));
+			workloads.push_back(RunWorkload("halt_idle", halt_idle_rom.GetPath(), num_frames));
+		}
+		for (const auto &rom_file_path : rom_file_paths)
+		{
+			workloads.push_back(RunWorkload(rom_file_path, rom_file_path, num_frames));
+		}
+
+		const auto json = ToJson(workloads, RunMicrobenchmarks());
+		std::fputs(json.c_str(), stdout);
+
+		if (!json_file_path.empty())
+		{
+			std::ofstream json_file{ json_file_path, std::ios::trunc };
+			json_file << json;
+			if (!json_file) { throw std::runtime_error{ "Could not write JSON file: " + json_file_path }; }
+		}
+	}
+	catch (std::exception &e)
+	{
+		std::fprintf(stderr, "Error: %s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
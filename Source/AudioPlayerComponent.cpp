@@ -1,9 +1,11 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "AudioPlayerComponent.h"
-#include <numeric>
+#include <algorithm>
+#include <cmath>
 
 AudioPlayerComponent::AudioPlayerComponent()
 {
+	ring_buffer_.SetCapacity(ring_buffer_capacity_);
 	setAudioChannels(0, 2);
 }
 
@@ -14,25 +16,18 @@ AudioPlayerComponent::~AudioPlayerComponent()
 
 void AudioPlayerComponent::ClearBuffer()
 {
-	abstract_fifo_.reset();
+	// Only the audio thread reads from the ring buffer
+	clear_requested_.store(true);
 }
 
 void AudioPlayerComponent::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
 {
-	// Due to how Juce's AbstractFifo works internally, the size needs to be set to 1 element bigger than intended
-	abstract_fifo_.setTotalSize(samplesPerBlockExpected + 1);
-	for (auto &output_channels : output_buffers_)
-	{
-		for (auto &channel_buffer : output_channels)
-		{
-			// The buffers themselves need to be 1 element bigger as well
-			channel_buffer.resize(samplesPerBlockExpected + 1);
-		}
-	}
+	read_buffer_.resize(samplesPerBlockExpected);
 
-	output_sample_rate_ = static_cast<size_t>(sampleRate);
-	downsampling_ratio_integer_part_ = APU::sample_rate_ / output_sample_rate_;
-	downsampling_ratio_remainder_ = APU::sample_rate_ % output_sample_rate_;
+	// Keep enough samples buffered for a couple of device blocks at least
+	const auto target_buffered_samples = std::max(static_cast<size_t>(sampleRate * target_buffered_seconds_), 2 * static_cast<size_t>(samplesPerBlockExpected));
+	target_buffered_samples_.store(std::min(target_buffered_samples, ring_buffer_.GetCapacity() / 2));
+	output_sample_rate_.store(static_cast<size_t>(sampleRate));
 }
 
 void AudioPlayerComponent::releaseResources()
@@ -44,102 +39,90 @@ void AudioPlayerComponent::getNextAudioBlock(const juce::AudioSourceChannelInfo
 {
 	bufferToFill.clearActiveBufferRegion();
 
-	if (abstract_fifo_.getNumReady() < bufferToFill.numSamples)
+	if (clear_requested_.exchange(false))
 	{
-		return;
+		ring_buffer_.Discard(ring_buffer_.GetNumReadable());
+		buffering_ = true;
 	}
 
-	int startIndexes[2]{ 0, 0 }, blockSizes[2]{ 0, 0 };
-	abstract_fifo_.prepareToRead(bufferToFill.numSamples, startIndexes[0], blockSizes[0], startIndexes[1], blockSizes[1]);
-	int writeOffsets[2]{ 0, blockSizes[0] };
-
-	// Convert APU amplitude from [0, APU::max_amplitude_] to [0, +0.50], then to [-0.25, +0.25]
-	constexpr auto max_amplitude = 0.50f;
-	constexpr auto half_max_amplitude = max_amplitude / 2.0f;
-	constexpr auto amplitude_divisor = APU::max_amplitude_ / max_amplitude;
-
-	//TODO: handle case of mono by mixing both outputs
-
-	for (int output_channel = 0; output_channel < bufferToFill.buffer->getNumChannels(); ++output_channel)
+	// After an underrun (or a clear), stay silent until the target level is reached again, rather than playing whatever trickles in
+	if (buffering_)
 	{
-		const auto output_index = output_channel % APU::num_outputs_;
+		if (ring_buffer_.GetNumReadable() < target_buffered_samples_.load()) return;
+		buffering_ = false;
+	}
 
-		float* const buffer = bufferToFill.buffer->getWritePointer(output_channel, bufferToFill.startSample);
+	// On underrun, the rest of the block stays silent, and buffering starts again
+	int num_samples_written{ 0 };
+	while ((num_samples_written < bufferToFill.numSamples) && !read_buffer_.empty())
+	{
+		const auto num_samples_to_read = std::min(static_cast<size_t>(bufferToFill.numSamples - num_samples_written), read_buffer_.size());
+		const auto num_samples_read = ring_buffer_.Read(read_buffer_.data(), num_samples_to_read);
+		if (num_samples_read == 0)
+		{
+			buffering_ = true;
+			break;
+		}
 
-		// 2 blocks of data in the circular buffer
-		for (int block_index = 0; block_index < 2; ++block_index)
+		// Frames are already mixed: just deinterleave them (a mono device gets the left output)
+		for (int output_channel = 0; output_channel < bufferToFill.buffer->getNumChannels(); ++output_channel)
 		{
-			// Iterate through all 4 channels
-			for (int channel_index = 0; channel_index < APU::num_channels_; ++channel_index)
-			{
-				// If the channel has been disabled by the GUI, proceed to next
-				if (!channels_enabled_[channel_index]) continue;
-
-				// Contribute to all samples of this block
-				for (int sample_index = 0; sample_index < blockSizes[block_index]; ++sample_index)
-				{
-					buffer[writeOffsets[block_index] + sample_index] += output_buffers_[output_index][channel_index][startIndexes[block_index] + sample_index];
-				}
-			}
+			const auto output_index = output_channel % APU::num_outputs_;
 
-			// Once all channels have contributed, convert the amplitude of samples to the range of [-0.25, +0.25]
-			for (int sample_index = 0; sample_index < blockSizes[block_index]; ++sample_index)
+			float* const buffer = bufferToFill.buffer->getWritePointer(output_channel, bufferToFill.startSample + num_samples_written);
+			for (size_t sample_index = 0; sample_index < num_samples_read; ++sample_index)
 			{
-				buffer[writeOffsets[block_index] + sample_index] /= amplitude_divisor;
-				buffer[writeOffsets[block_index] + sample_index] -= half_max_amplitude;
+				buffer[sample_index] = read_buffer_[sample_index][output_index];
 			}
 		}
+
+		num_samples_written += static_cast<int>(num_samples_read);
 	}
+}
 
-	abstract_fifo_.finishedRead(bufferToFill.numSamples);
+size_t AudioPlayerComponent::GetAdjustedOutputSampleRate() const
+{
+	const auto output_sample_rate = output_sample_rate_.load();
+	const auto target_buffered_samples = target_buffered_samples_.load();
+	if ((output_sample_rate == 0) || (target_buffered_samples == 0)) return 0;
+
+	// Produce slightly more samples when below the target level, and slightly less when above it
+	const auto buffered_samples = ring_buffer_.GetNumReadable();
+	const auto deviation = std::clamp((static_cast<double>(target_buffered_samples) - buffered_samples) / target_buffered_samples, -1.0, 1.0);
+	return static_cast<size_t>(std::llround(output_sample_rate * (1.0 + max_rate_deviation_ * deviation)));
 }
 
-void AudioPlayerComponent::OnNewSamples(APU::SampleBatch &sample_batch)
+void AudioPlayerComponent::OnNewSamples(const APU::OutputSample *output_samples, size_t num_output_samples)
 {
-	for (int output_index = 0; output_index < APU::num_outputs_; ++output_index)
-	{
-		for (int channel_index = 0; channel_index < APU::num_channels_; ++channel_index)
-		{
-			input_sample_accumulators_[output_index][channel_index] += sample_batch[output_index][channel_index];
-		}
-	}
+	// Convert APU amplitude from [0, APU::max_amplitude_] to [0, +0.50], then to [-0.25, +0.25]
+	constexpr auto max_amplitude = 0.50f;
+	constexpr auto half_max_amplitude = max_amplitude / 2.0f;
+	constexpr auto amplitude_divisor = APU::max_amplitude_ / max_amplitude;
 
-	if (++num_accumulated_apu_samples_ < downsampling_ratio_integer_part_) return;
+	// Samples above twice the target level are dropped, so that latency stays bounded when too many are produced (e.g. when fast-forwarding)
+	const auto max_buffered_samples = 2 * target_buffered_samples_.load();
+	const auto num_buffered_samples = ring_buffer_.GetNumReadable();
+	if (num_buffered_samples >= max_buffered_samples) return;
+	num_output_samples = std::min(num_output_samples, max_buffered_samples - num_buffered_samples);
 
-	while (abstract_fifo_.getFreeSpace() == 0)
+	// Channels disabled by the GUI get a gain of 0, so that mixing does not branch
+	const auto channels_enabled_mask = channels_enabled_mask_.load();
+	std::array<float, APU::num_channels_> channel_gains;
+	for (size_t channel_index = 0; channel_index < APU::num_channels_; ++channel_index)
 	{
-		std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+		channel_gains[channel_index] = ((channels_enabled_mask & (1 << channel_index)) != 0) ? 1.0f / amplitude_divisor : 0.0f;
 	}
 
-	int startIndex1{ 0 }, blockSize1{ 0 }, startIndex2{ 0 }, blockSize2{ 0 };
-	abstract_fifo_.prepareToWrite(1, startIndex1, blockSize1, startIndex2, blockSize2);
-
-	const auto sample_interpolation_ratio = static_cast<float>(downsampling_ratio_remainder_) / output_sample_rate_;
-
-	// Calculate the average of accumulated samples and push the values to the output buffers
-	for (int output_index = 0; output_index < APU::num_outputs_; ++output_index)
+	if (mix_buffer_.size() < num_output_samples) mix_buffer_.resize(num_output_samples);
+	for (size_t sample_index = 0; sample_index < num_output_samples; ++sample_index)
 	{
-		for (int channel_index = 0; channel_index < APU::num_channels_; ++channel_index)
+		for (size_t output_index = 0; output_index < APU::num_outputs_; ++output_index)
 		{
-			// Interpolate between previous and current accumulated values
-			output_buffers_[output_index][channel_index][startIndex1] = (sample_interpolation_ratio * previous_accumulator_values_[output_index][channel_index]
-				+ (1.0f - sample_interpolation_ratio) * input_sample_accumulators_[output_index][channel_index])
-				/ num_accumulated_apu_samples_;
-
-			previous_accumulator_values_[output_index][channel_index] = input_sample_accumulators_[output_index][channel_index];
-
-			// Clear input samples accumulators
-			input_sample_accumulators_[output_index][channel_index] = 0;
+			const auto &channel_samples = output_samples[sample_index][output_index];
+			mix_buffer_[sample_index][output_index] = channel_samples[0] * channel_gains[0] + channel_samples[1] * channel_gains[1]
+				+ channel_samples[2] * channel_gains[2] + channel_samples[3] * channel_gains[3] - half_max_amplitude;
 		}
 	}
 
-	num_accumulated_apu_samples_ = 0;
-
-	downsampling_ratio_remainder_ += APU::sample_rate_ % output_sample_rate_;
-	if (downsampling_ratio_remainder_ > output_sample_rate_)
-	{
-		downsampling_ratio_remainder_ -= output_sample_rate_;
-	}
-
-	abstract_fifo_.finishedWrite(1);
+	ring_buffer_.Write(mix_buffer_.data(), num_output_samples);
 }
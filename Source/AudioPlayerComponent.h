@@ -2,8 +2,11 @@
 
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "JucyBoy/APU.h"
+#include "SpscRingBuffer.h"
 #include <cstdint>
 #include <array>
+#include <atomic>
+#include <vector>
 
 class AudioPlayerComponent final : public juce::AudioAppComponent
 {
@@ -21,8 +24,16 @@ public:
 	void releaseResources() override;
 	void getNextAudioBlock(const juce::AudioSourceChannelInfo &bufferToFill) override;
 
-	// APU Listener functions
-	void OnNewSamples(APU::SampleBatch &sample_batch);
+	// Sample rate of the audio device (0 until prepareToPlay is called)
+	size_t GetOutputSampleRate() const { return output_sample_rate_.load(); }
+
+	// Dynamic rate control: the APU output sample rate to use next, deviating slightly from the one of the audio device
+	// in order to keep the buffered samples near a target level, regardless of the clock drift between emulation and device (0 if not known yet)
+	size_t GetAdjustedOutputSampleRate() const;
+
+	// APU Listener functions (called from the emulation thread, and never blocking: samples that do not fit in the buffer are dropped).
+	// Samples are mixed here, so that the audio thread only has to copy them to the device buffer.
+	void OnNewSamples(const APU::OutputSample *output_samples, size_t num_output_samples);
 
 	// GUI interaction
 	template <size_t channel_index>
@@ -31,22 +42,25 @@ public:
 	void EnableChannel(bool enabled);
 
 private:
-	using OutputBuffer = std::vector<float>;
-	std::array<std::array<OutputBuffer, APU::num_channels_>, APU::num_outputs_> output_buffers_{};
-	juce::AbstractFifo abstract_fifo_{ 1024 };
+	// Mixed output sample, one float per APU output (left, right)
+	using Frame = std::array<float, APU::num_outputs_>;
 
-	// Downsampling
-	size_t output_sample_rate_{ 0 };
-	size_t downsampling_ratio_integer_part_{ 0 };
-	size_t downsampling_ratio_remainder_{ 0 };
+	// Large enough for a few device blocks at any sample rate, so that neither the emulation nor the audio device ever wait for each other
+	static constexpr size_t ring_buffer_capacity_{ 16384 };
+	static constexpr double target_buffered_seconds_{ 0.05 };
+	static constexpr double max_rate_deviation_{ 0.005 };
 
-	APU::SampleBatch input_sample_accumulators_{};
-	size_t num_accumulated_apu_samples_{ 0 };
+	SpscRingBuffer<Frame> ring_buffer_;
+	std::vector<Frame> mix_buffer_;		// Emulation thread only
+	std::vector<Frame> read_buffer_;	// Audio thread only
+	std::atomic<bool> clear_requested_{ false };
+	bool buffering_{ true };	// Audio thread only
 
-	APU::SampleBatch previous_accumulator_values_{};
+	std::atomic<size_t> output_sample_rate_{ 0 };
+	std::atomic<size_t> target_buffered_samples_{ 0 };
 
-	// GUI interaction
-	std::array<bool, APU::num_channels_> channels_enabled_{ true, true, true, true };
+	// GUI interaction (one bit per channel, read when mixing)
+	std::atomic<uint8_t> channels_enabled_mask_{ 0x0F };
 
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioPlayerComponent)
 };
@@ -55,12 +69,13 @@ template <size_t channel_index>
 bool AudioPlayerComponent::IsChannelEnabled() const
 {
 	static_assert(channel_index < APU::num_channels_);
-	return channels_enabled_[channel_index];
+	return (channels_enabled_mask_.load() & (1 << channel_index)) != 0;
 }
 
 template <size_t channel_index>
 void AudioPlayerComponent::EnableChannel(bool enabled)
 {
 	static_assert(channel_index < APU::num_channels_);
-	channels_enabled_[channel_index] = enabled;
+	if (enabled) channels_enabled_mask_.fetch_or(1 << channel_index);
+	else channels_enabled_mask_.fetch_and(static_cast<uint8_t>(~(1 << channel_index)));
 }
@@ -0,0 +1,222 @@
+#include "AudioRecorder.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+	constexpr size_t num_recorded_outputs{ 2 };
+	constexpr size_t bytes_per_sample{ 2 };
+
+	// Convert APU amplitude from [0, APU::max_amplitude_] to [-0.25, +0.25] of the full 16-bit scale (as done by AudioPlayerComponent).
+	// Each stem gets its share of the offset, so that the stems add up to the mix.
+	int16_t ToPcm(float amplitude, float offset)
+	{
+		return static_cast<int16_t>((amplitude / APU::max_amplitude_ - offset) * 0.5f * 32767.0f);
+	}
+
+	void PutLittleEndian(std::vector<char> &bytes, uint32_t value, size_t num_bytes)
+	{
+		for (size_t i = 0; i < num_bytes; ++i)
+		{
+			bytes.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+		}
+	}
+
+	std::string GetStemFilePath(const std::string &file_path, size_t channel_index)
+	{
+		const auto suffix = ".ch" + std::to_string(channel_index + 1);
+
+		auto stem_file_path = file_path;
+		const auto last_dot_position = stem_file_path.find_last_of('.');
+		const auto last_separator_position = stem_file_path.find_last_of("/\\");
+		if ((std::string::npos != last_dot_position) && ((std::string::npos == last_separator_position) || (last_dot_position > last_separator_position)))
+		{
+			stem_file_path.insert(last_dot_position, suffix);
+		}
+		else
+		{
+			stem_file_path.append(suffix);
+		}
+		return stem_file_path;
+	}
+}
+
+AudioRecorder::AudioRecorder(const std::string &file_path, size_t sample_rate, Format format, bool record_stems, OverflowPolicy overflow_policy) :
+	sample_rate_{ sample_rate },
+	format_{ format },
+	overflow_policy_{ overflow_policy }
+{
+	if ((sample_rate == 0) || (sample_rate > APU::sample_rate_)) { throw std::invalid_argument{ "Invalid audio recording sample rate: " + std::to_string(sample_rate) }; }
+
+	std::vector<std::string> file_paths{ file_path };
+	if (record_stems)
+	{
+		for (size_t channel_index = 0; channel_index < APU::num_channels_; ++channel_index)
+		{
+			file_paths.push_back(GetStemFilePath(file_path, channel_index));
+		}
+	}
+
+	for (const auto &path : file_paths)
+	{
+		files_.emplace_back(path, std::ios::binary | std::ios::trunc);
+		if (!files_.back()) { throw std::runtime_error{ "Could not open audio recording file: " + path }; }
+
+		// Sizes are not known yet: the header is written again when stopping
+		if (format_ == Format::Wav) WriteWavHeader(files_.back(), 0);
+	}
+
+	ring_buffer_.SetCapacity(ring_buffer_capacity_);
+	writer_loop_function_result_ = std::async(std::launch::async, &AudioRecorder::WriterLoopFunction, this);
+}
+
+AudioRecorder::~AudioRecorder()
+{
+	try
+	{
+		Stop();
+	}
+	catch (std::exception &)
+	{
+		// Errors can only be reported by calling Stop explicitly
+	}
+}
+
+void AudioRecorder::Stop()
+{
+	if (!writer_loop_function_result_.valid()) { return; }
+
+	exit_writer_loop_.store(true);
+	writer_condition_.notify_one();
+
+	// get() will throw if any exception was thrown in the writer loop (see CPU::Stop regarding the use of std::shared_future)
+	auto shared_future = writer_loop_function_result_.share();
+	shared_future.get();
+
+	if (format_ == Format::Wav)
+	{
+		const auto data_size = num_samples_written_ * num_recorded_outputs * bytes_per_sample;
+		if (data_size > std::numeric_limits<uint32_t>::max() - 36) { throw std::runtime_error{ "Audio recording too long for a WAV file: " + std::to_string(data_size) + " bytes" }; }
+
+		for (auto &file : files_)
+		{
+			file.seekp(0);
+			WriteWavHeader(file, static_cast<uint32_t>(data_size));
+		}
+	}
+
+	for (auto &file : files_)
+	{
+		file.close();
+		if (!file) { throw std::runtime_error{ "Could not write audio recording file" }; }
+	}
+}
+
+void AudioRecorder::OnNewSamples(const APU::OutputSample *output_samples, size_t num_output_samples)
+{
+	auto num_samples_written = ring_buffer_.Write(output_samples, num_output_samples);
+	writer_condition_.notify_one();
+
+	// The writer loop only exits when stopping, or on errors (which are reported by Stop): do not wait for it then
+	while ((overflow_policy_ == OverflowPolicy::Wait) && (num_samples_written < num_output_samples) && !exit_writer_loop_.load())
+	{
+		std::this_thread::yield();
+		num_samples_written += ring_buffer_.Write(output_samples + num_samples_written, num_output_samples - num_samples_written);
+	}
+
+	num_dropped_samples_ += num_output_samples - num_samples_written;
+}
+
+void AudioRecorder::WriterLoopFunction()
+{
+	try
+	{
+		std::vector<APU::OutputSample> block(write_block_size_);
+		for (;;)
+		{
+			// Read the exit flag before draining, so that no samples written before Stop are left behind
+			const auto exit = exit_writer_loop_.load();
+
+			while (const auto num_samples_read = ring_buffer_.Read(block.data(), block.size()))
+			{
+				WriteSamples(block.data(), num_samples_read);
+			}
+
+			if (exit) break;
+
+			std::unique_lock<std::mutex> lock{ writer_mutex_ };
+			writer_condition_.wait_for(lock, std::chrono::milliseconds{ 10 }, [this]() { return exit_writer_loop_.load() || (ring_buffer_.GetNumReadable() >= write_block_size_); });
+		}
+	}
+	catch (std::exception &)
+	{
+		exit_writer_loop_.store(true);
+
+		// Rethrow the exception that was just caught, in order to retrieve it later via future::get()
+		throw;
+	}
+}
+
+void AudioRecorder::WriteSamples(const APU::OutputSample *output_samples, size_t num_output_samples)
+{
+	// Interleaved left/right
+	std::vector<std::vector<int16_t>> pcm_samples(files_.size(), std::vector<int16_t>(num_output_samples * num_recorded_outputs));
+
+	for (size_t sample_index = 0; sample_index < num_output_samples; ++sample_index)
+	{
+		for (size_t output_index = 0; output_index < num_recorded_outputs; ++output_index)
+		{
+			const auto &channel_samples = output_samples[sample_index][output_index];
+			const auto pcm_index = sample_index * num_recorded_outputs + output_index;
+
+			auto mix_amplitude = 0.0f;
+			for (size_t channel_index = 0; channel_index < APU::num_channels_; ++channel_index)
+			{
+				mix_amplitude += channel_samples[channel_index];
+				if (files_.size() > 1) pcm_samples[1 + channel_index][pcm_index] = ToPcm(channel_samples[channel_index], 0.5f / APU::num_channels_);
+			}
+			pcm_samples[0][pcm_index] = ToPcm(mix_amplitude, 0.5f);
+		}
+	}
+
+	std::vector<char> bytes;
+	bytes.reserve(num_output_samples * num_recorded_outputs * bytes_per_sample);
+	for (size_t file_index = 0; file_index < files_.size(); ++file_index)
+	{
+		// Little endian, regardless of the host
+		bytes.clear();
+		for (const auto sample : pcm_samples[file_index])
+		{
+			PutLittleEndian(bytes, static_cast<uint16_t>(sample), bytes_per_sample);
+		}
+
+		files_[file_index].write(bytes.data(), bytes.size());
+		if (!files_[file_index]) { throw std::runtime_error{ "Could not write audio recording file" }; }
+	}
+
+	num_samples_written_ += num_output_samples;
+}
+
+void AudioRecorder::WriteWavHeader(std::ofstream &file, uint32_t data_size) const
+{
+	const auto block_align = static_cast<uint32_t>(num_recorded_outputs * bytes_per_sample);
+
+	std::vector<char> header{ 'R', 'I', 'F', 'F' };
+	PutLittleEndian(header, 36 + data_size, 4);
+	header.insert(header.end(), { 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' });
+	PutLittleEndian(header, 16, 4);									// Format chunk size
+	PutLittleEndian(header, 1, 2);									// PCM
+	PutLittleEndian(header, static_cast<uint32_t>(num_recorded_outputs), 2);
+	PutLittleEndian(header, static_cast<uint32_t>(sample_rate_), 4);
+	PutLittleEndian(header, static_cast<uint32_t>(sample_rate_) * block_align, 4);	// Byte rate
+	PutLittleEndian(header, block_align, 2);
+	PutLittleEndian(header, 8 * bytes_per_sample, 2);				// Bits per sample
+	header.insert(header.end(), { 'd', 'a', 't', 'a' });
+	PutLittleEndian(header, data_size, 4);
+
+	file.write(header.data(), header.size());
+	if (!file) { throw std::runtime_error{ "Could not write audio recording file" }; }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "JucyBoy/APU.h"
+#include "SpscRingBuffer.h"
+
+// Streams the APU output to disk as 16-bit stereo PCM: the final mix and, optionally, one stem per channel (in files named <name>.ch1.<extension>, etc.).
+// Stems are scaled as in the mix, so that they add up to it. Files are written either as WAV or as headerless little endian PCM.
+//
+// OnNewSamples only copies the samples into a bounded ring buffer, which a background thread drains to disk.
+// When the writer falls behind and the buffer is full, samples are either dropped (and counted) or waited for room, depending on the overflow policy:
+// dropping never blocks the emulation, while waiting guarantees complete recordings (e.g. for regression testing).
+class AudioRecorder final
+{
+public:
+	enum class Format { Wav, Raw };
+	enum class OverflowPolicy { Drop, Wait };
+
+	AudioRecorder(const std::string &file_path, size_t sample_rate, Format format, bool record_stems, OverflowPolicy overflow_policy);
+	~AudioRecorder();
+
+	// Flushes the buffered samples and closes the files. If an exception was thrown in the writer thread, Stop will rethrow it.
+	void Stop();
+
+	// APU output listener function
+	void OnNewSamples(const APU::OutputSample *output_samples, size_t num_output_samples);
+
+	size_t GetNumDroppedSamples() const { return num_dropped_samples_.load(); }
+
+private:
+	void WriterLoopFunction();
+	void WriteSamples(const APU::OutputSample *output_samples, size_t num_output_samples);
+	void WriteWavHeader(std::ofstream &file, uint32_t data_size) const;
+
+	static constexpr size_t ring_buffer_capacity_{ 1 << 16 };
+	static constexpr size_t write_block_size_{ 4096 };
+
+	const size_t sample_rate_;
+	const Format format_;
+	const OverflowPolicy overflow_policy_;
+
+	// The mix first, then the stems (if any)
+	std::vector<std::ofstream> files_;
+	uint64_t num_samples_written_{ 0 };
+
+	SpscRingBuffer<APU::OutputSample> ring_buffer_;
+	std::atomic<size_t> num_dropped_samples_{ 0 };
+
+	// The writer thread waits with a timeout, so that producers never have to lock the mutex in order to notify it
+	std::mutex writer_mutex_;
+	std::condition_variable writer_condition_;
+	std::atomic<bool> exit_writer_loop_{ false };
+	std::future<void> writer_loop_function_result_;
+};
@@ -0,0 +1,154 @@
+// jucyboy-headless: runs the emulator core without any GUI or audio device, as fast as possible.
+//
+// Usage: jucyboy-headless <rom file> [options]
+//   --frames <n>          Number of frames to run (default: 60)
+//   --framebuffer <file>  Dump the final framebuffer as a binary PGM image
+//   --audio <file>        Record the audio output as signed 16-bit stereo PCM: a WAV file if the extension is .wav, raw otherwise
+//   --audio-rate <hz>     Sample rate of the audio recording (default: 44100)
+//   --audio-stems         Also record each APU channel to its own file (<file name>.ch1.<extension>, etc.)
+//   --memory <file>       Dump the final memory map (64 KiB, as read by the CPU)
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include "JucyBoy/JucyBoy.h"
+#include "AudioRecorder.h"
+
+namespace
+{
+	struct Options
+	{
+		std::string rom_file_path;
+		size_t num_frames{ 60 };
+		std::string framebuffer_file_path;
+		std::string audio_file_path;
+		size_t audio_sample_rate{ 44100 };
+		bool audio_stems{ false };
+		std::string memory_file_path;
+	};
+
+	Options ParseOptions(int argc, char *argv[])
+	{
+		if (argc < 2) { throw std::invalid_argument{ "Missing ROM file" }; }
+
+		Options options;
+		options.rom_file_path = argv[1];
+
+		for (int i = 2; i < argc; ++i)
+		{
+			const std::string option{ argv[i] };
+			if (option == "--audio-stems")
+			{
+				options.audio_stems = true;
+				continue;
+			}
+
+			if (i + 1 >= argc) { throw std::invalid_argument{ "Missing value for option " + option }; }
+			const std::string value{ argv[++i] };
+
+			if (option == "--frames") options.num_frames = std::stoul(value);
+			else if (option == "--framebuffer") options.framebuffer_file_path = value;
+			else if (option == "--audio") options.audio_file_path = value;
+			else if (option == "--audio-rate") options.audio_sample_rate = std::stoul(value);
+			else if (option == "--memory") options.memory_file_path = value;
+			else throw std::invalid_argument{ "Unknown option " + option };
+		}
+
+		if ((options.audio_sample_rate == 0) || (options.audio_sample_rate > APU::sample_rate_))
+		{
+			throw std::invalid_argument{ "Invalid audio sample rate: " + std::to_string(options.audio_sample_rate) };
+		}
+
+		return options;
+	}
+
+	bool EndsWith(const std::string &text, const std::string &suffix)
+	{
+		return (text.size() >= suffix.size()) && (text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0);
+	}
+
+	std::ofstream OpenOutputFile(const std::string &file_path)
+	{
+		std::ofstream file{ file_path, std::ios::binary | std::ios::trunc };
+		if (!file) { throw std::runtime_error{ "Could not open output file: " + file_path }; }
+		return file;
+	}
+
+	void DumpFramebuffer(const PPU::Framebuffer &framebuffer, const std::string &file_path)
+	{
+		constexpr std::array<uint8_t, static_cast<size_t>(PPU::Color::Count)> grey_levels{ 0xFF, 0xAA, 0x55, 0x00 };
+
+		auto file = OpenOutputFile(file_path);
+		file << "P5\n160 144\n255\n";
+		for (const auto color : framebuffer)
+		{
+			file.put(static_cast<char>(grey_levels[static_cast<size_t>(color)]));
+		}
+	}
+
+	void DumpMemory(const Memory::Map &memory_map, const std::string &file_path)
+	{
+		auto file = OpenOutputFile(file_path);
+		file.write(reinterpret_cast<const char*>(memory_map.data()), memory_map.size());
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	Options options;
+	try
+	{
+		options = ParseOptions(argc, argv);
+	}
+	catch (std::exception &e)
+	{
+		std::fprintf(stderr, "%s\n\nUsage: %s <rom file> [--frames <n>] [--framebuffer <file>] [--audio <file>] [--audio-rate <hz>] [--audio-stems] [--memory <file>]\n", e.what(), argv[0]);
+		return 2;
+	}
+
+	try
+	{
+		JucyBoy jucy_boy{ options.rom_file_path };
+
+		// Recordings are used for regression testing, so they must be complete: wait for the writer thread rather than dropping samples
+		std::unique_ptr<AudioRecorder> audio_recorder;
+		if (!options.audio_file_path.empty())
+		{
+			const auto audio_format = EndsWith(options.audio_file_path, ".wav") ? AudioRecorder::Format::Wav : AudioRecorder::Format::Raw;
+			audio_recorder = std::make_unique<AudioRecorder>(options.audio_file_path, options.audio_sample_rate, audio_format, options.audio_stems, AudioRecorder::OverflowPolicy::Wait);
+			jucy_boy.GetApu().SetOutputSampleRate(options.audio_sample_rate);
+			jucy_boy.GetApu().AddOutputListener([&audio_recorder](const APU::OutputSample *output_samples, size_t num_output_samples) { audio_recorder->OnNewSamples(output_samples, num_output_samples); });
+		}
+
+		// One machine cycle is 4 clock cycles
+		const uint64_t num_machine_cycles = options.num_frames * (PPU::frame_duration_ / 4);
+
+		const auto start_time = std::chrono::steady_clock::now();
+		jucy_boy.RunMachineCycles(num_machine_cycles);
+		const auto elapsed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+		if (!options.framebuffer_file_path.empty()) DumpFramebuffer(jucy_boy.GetPpu().GetFramebuffer(), options.framebuffer_file_path);
+		if (audio_recorder) audio_recorder->Stop();
+		if (!options.memory_file_path.empty()) DumpMemory(jucy_boy.GetMmu().GetMemoryMap(), options.memory_file_path);
+
+		const auto emulated_clock_cycles = 4.0 * static_cast<double>(jucy_boy.GetScheduler().GetCurrentCycle());
+		std::printf("frames=%zu seconds=%.3f fps=%.1f clock_cycles=%.0f emulated_mhz=%.3f\n", options.num_frames, elapsed_seconds,
+			options.num_frames / elapsed_seconds, emulated_clock_cycles, emulated_clock_cycles / elapsed_seconds / 1e6);
+
+		// How often the ROM writes PPU registers in the middle of a line (raster effects)
+		const auto &rendering_statistics = jucy_boy.GetPpu().GetRenderingStatistics();
+		std::printf("lines=%llu lines_with_mid_line_writes=%llu mid_line_writes=%llu\n", static_cast<unsigned long long>(rendering_statistics.num_lines),
+			static_cast<unsigned long long>(rendering_statistics.num_lines_with_mid_line_writes), static_cast<unsigned long long>(rendering_statistics.num_mid_line_writes));
+	}
+	catch (std::exception &e)
+	{
+		std::fprintf(stderr, "Error: %s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
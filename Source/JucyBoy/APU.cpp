@@ -1,39 +1,101 @@
 #include "APU.h"
+#include <algorithm>
+#include <limits>
 #include <string>
 
+APU::APU()
+{
+	ResetOutput();
+}
+
 void APU::OnMachineCycleLapse()
 {
-	for (int ii = 0; ii < 2; ++ii)
+	OnMachineCyclesLapsed(1);
+}
+
+void APU::OnMachineCyclesLapsed(size_t num_machine_cycles)
+{
+	// Clock cycles are lapsed in chunks that end at the next frame sequencer tick at most, since it changes how the channels are clocked.
+	// When sampling, chunks also end at the next channel tick (so that the channel samples are constant within a chunk) and at the end of the sample block,
+	// unless all samples are needed (i.e. one per 2 clock cycles).
+	// Register writes since the previous lapse may have changed the output already, from the first sample of the first chunk.
+	if (AreOutputSamplesNeeded())
 	{
-		if (apu_enabled_)
-		{
-			channel_1_.OnClockCyclesLapsed(2);
-			channel_2_.OnClockCyclesLapsed(2);
-			channel_3_.OnClockCyclesLapsed(2);
-			channel_4_.OnClockCyclesLapsed(2);
+		const auto channel_samples = GetChannelSamples();
+		if (channel_samples != output_channel_samples_) AddOutputDeltas(channel_samples, num_samples_in_block_);
+	}
 
-			frame_sequencer_divider_.OnInputClockCyclesLapsed(2);
+	for (auto clock_cycles_left = num_machine_cycles * 4; clock_cycles_left > 0;)
+	{
+		size_t num_clock_cycles{ 0 };
+		if (AreSamplesNeeded())
+		{
+			num_clock_cycles = 2;
+		}
+		else if (AreOutputSamplesNeeded())
+		{
+			num_clock_cycles = std::min({ clock_cycles_left, GetClockCyclesUntilNextTick(), 2 * (sample_block_.size() - num_samples_in_block_) });
+		}
+		else
+		{
+			num_clock_cycles = std::min(clock_cycles_left, apu_enabled_ ? frame_sequencer_divider_.GetInputClockCyclesLeft() : clock_cycles_left);
 		}
 
-		SampleBatch sample_batch;
-		const auto channel_1_sample = channel_1_.GetSample();
-		const auto channel_2_sample = channel_2_.GetSample();
-		const auto channel_3_sample = channel_3_.GetSample();
-		const auto channel_4_sample = channel_4_.GetSample();
+		LapseClockCycles(num_clock_cycles);
+		clock_cycles_left -= num_clock_cycles;
+	}
+}
 
-		for (int output_index = 0; output_index < num_outputs_; ++output_index)
+void APU::LapseClockCycles(size_t num_clock_cycles)
+{
+	if (apu_enabled_)
+	{
+		channel_1_.OnClockCyclesLapsed(num_clock_cycles);
+		channel_2_.OnClockCyclesLapsed(num_clock_cycles);
+		channel_3_.OnClockCyclesLapsed(num_clock_cycles);
+		channel_4_.OnClockCyclesLapsed(num_clock_cycles);
+
+		for (auto num_ticks = frame_sequencer_divider_.OnInputClockCyclesLapsed(num_clock_cycles); num_ticks > 0; --num_ticks)
 		{
-			sample_batch[output_index][0] = ((channels_enabled_[output_index] & 0x01) != 0) * channel_1_sample * (master_volumes_[output_index] + 1);
-			sample_batch[output_index][1] = ((channels_enabled_[output_index] & 0x02) != 0) * channel_2_sample * (master_volumes_[output_index] + 1);
-			sample_batch[output_index][2] = ((channels_enabled_[output_index] & 0x04) != 0) * channel_3_sample * (master_volumes_[output_index] + 1);
-			sample_batch[output_index][3] = ((channels_enabled_[output_index] & 0x08) != 0) * channel_4_sample * (master_volumes_[output_index] + 1);
+			OnFrameSequencerClocked();
 		}
+	}
+
+	// Samples are not generated if nobody is listening (or while muted)
+	if (!AreSamplesNeeded() && !AreOutputSamplesNeeded()) return;
+
+	// Samples are the same for the whole chunk of clock cycles, but channels may have changed their output at its last sample
+	const auto num_samples = num_clock_cycles / 2;
+	const auto channel_samples = GetChannelSamples();
+	if (AreSamplesNeeded()) sample_block_[num_samples_in_block_] = MixSampleBatch(channel_samples);
+
+	// Most of the time no channel changes its output, so that there are no deltas to add
+	if (AreOutputSamplesNeeded() && (channel_samples != output_channel_samples_)) AddOutputDeltas(channel_samples, num_samples_in_block_ + num_samples - 1);
 
-		// Notify listeners
-		NotifyNewSample(sample_batch);
+	// Notify listeners once the block is complete
+	num_samples_in_block_ += num_samples;
+	if (num_samples_in_block_ == sample_block_.size())
+	{
+		FlushSamples();
 	}
 }
 
+size_t APU::GetClockCyclesUntilNextTick() const
+{
+	if (!apu_enabled_) return std::numeric_limits<size_t>::max();
+
+	return std::min({ channel_1_.GetClockCyclesUntilNextTick(), channel_2_.GetClockCyclesUntilNextTick(), channel_3_.GetClockCyclesUntilNextTick(),
+		channel_4_.GetClockCyclesUntilNextTick(), frame_sequencer_divider_.GetInputClockCyclesLeft() });
+}
+
+size_t APU::GetMachineCyclesUntilNextEvent() const
+{
+	// The APU does not request interrupts, but samples must still be delivered to the listeners regularly (i.e. not only when its registers are accessed).
+	// The frame sequencer period (512 Hz) is used for that purpose.
+	const auto clock_cycles_until_next_event = apu_enabled_ ? frame_sequencer_divider_.GetInputClockCyclesLeft() : (input_clock_frequency_ / frame_sequencer_frequency_);
+	return (clock_cycles_until_next_event + 3) / 4;
+}
+
 void APU::OnFrameSequencerClocked()
 {
 	switch (frame_sequencer_step_)
@@ -223,10 +285,12 @@ void APU::OnIoMemoryWritten(Memory::Address address, uint8_t value)
 	case Memory::NR50:
 		master_volumes_[Outputs::Right] = value & 0x07;
 		master_volumes_[Outputs::Left] = (value & 0x70) >> 4;
+		if (AreOutputSamplesNeeded()) AddOutputDeltas(output_channel_samples_, num_samples_in_block_);
 		break;
 	case Memory::NR51:
 		channels_enabled_[Outputs::Right] = value & 0x0F;
 		channels_enabled_[Outputs::Left] = (value & 0xF0) >> 4;
+		if (AreOutputSamplesNeeded()) AddOutputDeltas(output_channel_samples_, num_samples_in_block_);
 		break;
 	case Memory::NR52:
 		{const auto was_apu_enabled = apu_enabled_;
@@ -301,10 +365,135 @@ std::function<void()> APU::AddListener(Listener listener)
 	return [it, this]() { listeners_.erase(it); };
 }
 
-void APU::NotifyNewSample(SampleBatch &sample_batch)
+void APU::SetSampleBlockSize(size_t num_sample_batches)
+{
+	if (num_sample_batches == 0) { throw std::invalid_argument{ "Invalid sample block size: " + std::to_string(num_sample_batches) }; }
+
+	FlushSamples();
+	sample_block_.resize(num_sample_batches);
+	ResetOutput();
+}
+
+void APU::FlushSamples()
+{
+	if (num_samples_in_block_ == 0) return;
+
+	NotifyNewSamples(sample_block_.data(), num_samples_in_block_);
+
+	if (AreOutputSamplesNeeded())
+	{
+		// All blip buffers have the same rates, hence the same number of samples available
+		for (auto &output_blip_buffers : blip_buffers_)
+		{
+			for (auto &blip_buffer : output_blip_buffers) { blip_buffer.EndFrame(num_samples_in_block_); }
+		}
+
+		const auto num_output_samples = blip_buffers_[0][0].GetNumSamplesAvailable();
+		for (size_t output_index = 0; output_index < num_outputs_; ++output_index)
+		{
+			for (size_t channel_index = 0; channel_index < num_channels_; ++channel_index)
+			{
+				blip_buffers_[output_index][channel_index].ReadSamples(&output_block_[0][output_index][channel_index], num_output_samples, num_outputs_ * num_channels_);
+			}
+		}
+
+		NotifyNewOutputSamples(output_block_.data(), num_output_samples);
+	}
+
+	num_samples_in_block_ = 0;
+	if (output_sample_rate_changed_) ApplyOutputSampleRate();
+}
+
+std::function<void()> APU::AddOutputListener(OutputListener listener)
+{
+	auto it = output_listeners_.emplace(output_listeners_.begin(), listener);
+	return [it, this]() { output_listeners_.erase(it); };
+}
+
+void APU::SetOutputSampleRate(size_t output_sample_rate)
+{
+	if ((output_sample_rate == 0) || (output_sample_rate > sample_rate_)) { throw std::invalid_argument{ "Invalid output sample rate: " + std::to_string(output_sample_rate) }; }
+
+	if (output_sample_rate == output_sample_rate_) return;
+
+	output_sample_rate_ = output_sample_rate;
+	output_sample_rate_changed_ = true;
+	if (num_samples_in_block_ == 0) ApplyOutputSampleRate();
+}
+
+APU::ChannelSamples APU::GetChannelSamples() const
+{
+	return{ channel_1_.GetSample(), channel_2_.GetSample(), channel_3_.GetSample(), channel_4_.GetSample() };
+}
+
+APU::SampleBatch APU::MixSampleBatch(const ChannelSamples &channel_samples) const
+{
+	SampleBatch sample_batch;
+	for (int output_index = 0; output_index < num_outputs_; ++output_index)
+	{
+		sample_batch[output_index][0] = ((channels_enabled_[output_index] & 0x01) != 0) * channel_samples[0] * (master_volumes_[output_index] + 1);
+		sample_batch[output_index][1] = ((channels_enabled_[output_index] & 0x02) != 0) * channel_samples[1] * (master_volumes_[output_index] + 1);
+		sample_batch[output_index][2] = ((channels_enabled_[output_index] & 0x04) != 0) * channel_samples[2] * (master_volumes_[output_index] + 1);
+		sample_batch[output_index][3] = ((channels_enabled_[output_index] & 0x08) != 0) * channel_samples[3] * (master_volumes_[output_index] + 1);
+	}
+	return sample_batch;
+}
+
+void APU::AddOutputDeltas(const ChannelSamples &channel_samples, size_t clock_time)
+{
+	output_channel_samples_ = channel_samples;
+
+	const auto sample_batch = MixSampleBatch(channel_samples);
+	for (size_t output_index = 0; output_index < num_outputs_; ++output_index)
+	{
+		for (size_t channel_index = 0; channel_index < num_channels_; ++channel_index)
+		{
+			const auto amplitude = sample_batch[output_index][channel_index];
+			auto &previous_amplitude = output_amplitudes_[output_index][channel_index];
+			if (amplitude == previous_amplitude) continue;
+
+			blip_buffers_[output_index][channel_index].AddDelta(clock_time, static_cast<int>(amplitude) - static_cast<int>(previous_amplitude));
+			previous_amplitude = amplitude;
+		}
+	}
+}
+
+void APU::ResetOutput()
+{
+	ApplyOutputSampleRate();
+	for (auto &output_blip_buffers : blip_buffers_)
+	{
+		for (auto &blip_buffer : output_blip_buffers) { blip_buffer.Clear(); }
+	}
+	output_channel_samples_ = ChannelSamples{};
+	output_amplitudes_ = SampleBatch{};
+}
+
+void APU::ApplyOutputSampleRate()
+{
+	// A frame lasts one sample block at most
+	for (auto &output_blip_buffers : blip_buffers_)
+	{
+		for (auto &blip_buffer : output_blip_buffers) { blip_buffer.SetRates(sample_rate_, output_sample_rate_, sample_block_.size()); }
+	}
+	output_sample_rate_changed_ = false;
+
+	// Enough room for the samples of a whole frame (plus one, due to rounding)
+	output_block_.resize((sample_block_.size() * output_sample_rate_) / sample_rate_ + 2);
+}
+
+void APU::NotifyNewSamples(const SampleBatch *sample_batches, size_t num_sample_batches)
 {
 	for (auto& listener : listeners_)
 	{
-		listener(sample_batch);
+		listener(sample_batches, num_sample_batches);
+	}
+}
+
+void APU::NotifyNewOutputSamples(const OutputSample *output_samples, size_t num_output_samples)
+{
+	for (auto& listener : output_listeners_)
+	{
+		listener(output_samples, num_output_samples);
 	}
 }
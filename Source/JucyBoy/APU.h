@@ -4,10 +4,12 @@
 #include <functional>
 #include <list>
 #include <array>
+#include <vector>
 #include "Memory.h"
 #include "APU/SquareChannel.h"
 #include "APU/WaveChannel.h"
 #include "APU/NoiseChannel.h"
+#include "APU/BlipBuffer.h"
 #include "CPU.h"
 
 class APU final
@@ -28,11 +30,13 @@ public:
 	static constexpr size_t sample_rate_{ input_clock_frequency_ / 2 };
 	static constexpr size_t max_amplitude_{ max_master_volume_ * num_channels_ * max_channel_volume_ };
 
-	APU() = default;
+	APU();
 	~APU() = default;
 
-	// CPU::Listener overrides
+	// Scheduler functions
 	void OnMachineCycleLapse();
+	void OnMachineCyclesLapsed(size_t num_machine_cycles);
+	size_t GetMachineCyclesUntilNextEvent() const;
 
 	// Frame Sequencer callback function
 	void OnFrameSequencerClocked();
@@ -42,21 +46,58 @@ public:
 	void OnIoMemoryWritten(Memory::Address address, uint8_t value);
 
 	// AddListener returns a deregister function that can be called with no arguments
+	// Samples are delivered in blocks (one per scanline by default), rather than one by one
 	using SampleBatch = std::array<std::array<size_t, num_channels_>, num_outputs_>;
-	using Listener = std::function<void(SampleBatch &sample_batch)>;
+	using Listener = std::function<void(const SampleBatch *sample_batches, size_t num_sample_batches)>;
 	std::function<void()> AddListener(Listener listener);
 
+	static constexpr size_t default_sample_block_size_{ 456 / 2 };
+	void SetSampleBlockSize(size_t num_sample_batches);
+	size_t GetSampleBlockSize() const { return sample_block_.size(); }
+
+	// Delivers the samples of the current block to the listeners, even if the block is not complete yet
+	void FlushSamples();
+
+	// AddOutputListener returns a deregister function that can be called with no arguments
+	// Output samples are band-limited and resampled to the output sample rate (e.g. that of the audio device), delivered along with the samples of each block
+	using OutputSample = std::array<std::array<float, num_channels_>, num_outputs_>;
+	using OutputListener = std::function<void(const OutputSample *output_samples, size_t num_output_samples)>;
+	std::function<void()> AddOutputListener(OutputListener listener);
+
+	// The output sample rate can be adjusted at any time (e.g. by the output listeners, to compensate for clock drift), and it is applied at the end of the current block
+	static constexpr size_t default_output_sample_rate_{ 44100 };
+	void SetOutputSampleRate(size_t output_sample_rate);
+	size_t GetOutputSampleRate() const { return output_sample_rate_; }
+
+	// While muted, samples are neither generated nor delivered to the listeners (e.g. while emulating frames that are not meant to be heard)
+	void SetMuted(bool muted) { muted_ = muted; }
+
 	template<class Archive>
 	void serialize(Archive &archive);
 
 private:
+	bool AreSamplesNeeded() const { return !muted_ && !listeners_.empty(); }
+	bool AreOutputSamplesNeeded() const { return !muted_ && !output_listeners_.empty(); }
+
+	void LapseClockCycles(size_t num_clock_cycles);
+	size_t GetClockCyclesUntilNextTick() const;
 	void ClockLengthCounters();
 
+	using ChannelSamples = std::array<size_t, num_channels_>;
+	ChannelSamples GetChannelSamples() const;
+	SampleBatch MixSampleBatch(const ChannelSamples &channel_samples) const;
+
+	// Adds the amplitude changes of each channel since the previous ones to the blip buffers
+	void AddOutputDeltas(const ChannelSamples &channel_samples, size_t clock_time);
+	void ResetOutput();
+	void ApplyOutputSampleRate();
+
 	// Listener notification
-	void NotifyNewSample(SampleBatch &sample_batch);
+	void NotifyNewSamples(const SampleBatch *sample_batches, size_t num_sample_batches);
+	void NotifyNewOutputSamples(const OutputSample *output_samples, size_t num_output_samples);
 
 private:
-	ClockDivider frame_sequencer_divider_{ input_clock_frequency_ / frame_sequencer_frequency_, std::bind(&APU::OnFrameSequencerClocked, this) };
+	ClockDivider frame_sequencer_divider_{ input_clock_frequency_ / frame_sequencer_frequency_ };
 	size_t frame_sequencer_step_{ 0 };
 
 	SquareChannelWithSweep channel_1_;
@@ -69,11 +110,30 @@ private:
 	std::array<size_t, num_outputs_> master_volumes_{7, 7};
 	std::array<uint8_t, num_outputs_> channels_enabled_{0x3, 0xF};
 
+	bool muted_{ false };
 	std::list<Listener> listeners_;
+	std::vector<SampleBatch> sample_block_ = std::vector<SampleBatch>(default_sample_block_size_);
+	size_t num_samples_in_block_{ 0 };
+
+	// One blip buffer per output and channel (clocked at sample_rate_, with a frame per block), so that listeners can still mix channels as they see fit
+	std::list<OutputListener> output_listeners_;
+	size_t output_sample_rate_{ default_output_sample_rate_ };
+	bool output_sample_rate_changed_{ false };
+	std::array<std::array<BlipBuffer, num_channels_>, num_outputs_> blip_buffers_;
+	ChannelSamples output_channel_samples_{};
+	SampleBatch output_amplitudes_{};
+	std::vector<OutputSample> output_block_;
 };
 
 template<class Archive>
 void APU::serialize(Archive &archive)
 {
-	archive(frame_sequencer_divider_, frame_sequencer_step_, channel_1_, channel_2_, apu_enabled_, master_volumes_, channels_enabled_);
+	// The samples of the current block are delivered first, so that the output stage is saved (or replaced) at a block boundary
+	FlushSamples();
+
+	archive(frame_sequencer_divider_, frame_sequencer_step_, channel_1_, channel_2_, channel_3_, channel_4_, apu_enabled_, master_volumes_, channels_enabled_);
+	archive(blip_buffers_, output_channel_samples_, output_amplitudes_);
+
+	// Loaded blip buffers need the current rates (when saving, flushing has already applied any pending rate change)
+	if (Archive::is_loading::value) ApplyOutputSampleRate();
 }
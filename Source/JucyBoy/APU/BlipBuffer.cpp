@@ -0,0 +1,113 @@
+#include "BlipBuffer.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+	constexpr double pi{ 3.14159265358979323846 };
+
+	// Cutoff frequency of the band-limited steps, relative to the output sample rate (i.e. slightly below Nyquist)
+	constexpr double cutoff_frequency{ 0.45 };
+
+	template<size_t num_phases, size_t kernel_width, int kernel_unit>
+	using Kernels = std::array<std::array<int32_t, kernel_width>, num_phases>;
+
+	// One kernel per fractional position (phase) of a step between two output samples: a Blackman-windowed sinc impulse.
+	// Each kernel is normalized so that its taps add up exactly to kernel_unit, so that integrating the buffer does not drift.
+	template<size_t num_phases, size_t kernel_width, int kernel_unit>
+	Kernels<num_phases, kernel_width, kernel_unit> ComputeKernels()
+	{
+		Kernels<num_phases, kernel_width, kernel_unit> kernels{};
+		for (size_t phase = 0; phase < num_phases; ++phase)
+		{
+			const auto fraction = static_cast<double>(phase) / num_phases;
+
+			std::array<double, kernel_width> taps{};
+			for (size_t tap = 0; tap < kernel_width; ++tap)
+			{
+				// Position relative to the step, which lies between taps (kernel_width / 2 - 1) and (kernel_width / 2)
+				const auto t = static_cast<double>(tap) - (kernel_width / 2 - 1) - fraction;
+				const auto x = 2.0 * cutoff_frequency * t;
+				const auto sinc = (x == 0.0) ? 1.0 : std::sin(pi * x) / (pi * x);
+				const auto window_position = (t + kernel_width / 2) / kernel_width;
+				const auto window = 0.42 - 0.5 * std::cos(2.0 * pi * window_position) + 0.08 * std::cos(4.0 * pi * window_position);
+				taps[tap] = sinc * window;
+			}
+
+			const auto sum = std::accumulate(taps.begin(), taps.end(), 0.0);
+			int32_t integer_sum{ 0 };
+			for (size_t tap = 0; tap < kernel_width; ++tap)
+			{
+				kernels[phase][tap] = static_cast<int32_t>(std::lround(taps[tap] / sum * kernel_unit));
+				integer_sum += kernels[phase][tap];
+			}
+
+			// Rounding errors go to the center tap
+			kernels[phase][kernel_width / 2] += kernel_unit - integer_sum;
+		}
+		return kernels;
+	}
+}
+
+void BlipBuffer::SetRates(size_t clock_rate, size_t sample_rate, size_t max_frame_duration)
+{
+	if ((sample_rate == 0) || (sample_rate > clock_rate)) { throw std::invalid_argument{ "Invalid BlipBuffer sample rate: " + std::to_string(sample_rate) }; }
+
+	time_factor_ = static_cast<uint64_t>(std::llround(std::ldexp(static_cast<double>(sample_rate) / clock_rate, time_bits_)));
+
+	// Room for the samples of a whole frame, plus the ones not available yet (due to the kernel width)
+	const auto max_frame_samples = (max_frame_duration * time_factor_ >> time_bits_) + 1;
+	buffer_.resize(std::max(buffer_.size(), max_frame_samples + kernel_width_ + 1), 0);
+}
+
+void BlipBuffer::Clear()
+{
+	offset_ = 0;
+	integrator_ = 0;
+	std::fill(buffer_.begin(), buffer_.end(), 0);
+}
+
+void BlipBuffer::AddDelta(size_t clock_time, int delta)
+{
+	static const auto kernels = ComputeKernels<num_phases_, kernel_width_, kernel_unit_>();
+
+	const auto time = offset_ + clock_time * time_factor_;
+	const auto sample_index = static_cast<size_t>(time >> time_bits_);
+	const auto phase = static_cast<size_t>(time >> (time_bits_ - phase_bits_)) & (num_phases_ - 1);
+
+	if (sample_index + kernel_width_ > buffer_.size()) { throw std::logic_error{ "BlipBuffer overflow, at sample: " + std::to_string(sample_index) }; }
+
+	const auto &kernel = kernels[phase];
+	auto *samples = &buffer_[sample_index];
+	for (size_t tap = 0; tap < kernel_width_; ++tap)
+	{
+		samples[tap] += kernel[tap] * delta;
+	}
+}
+
+void BlipBuffer::EndFrame(size_t frame_duration)
+{
+	offset_ += frame_duration * time_factor_;
+
+	if (GetNumSamplesAvailable() + kernel_width_ > buffer_.size()) { throw std::logic_error{ "BlipBuffer overflow, with samples available: " + std::to_string(GetNumSamplesAvailable()) }; }
+}
+
+void BlipBuffer::ReadSamples(float *samples, size_t num_samples, size_t stride)
+{
+	if (num_samples > GetNumSamplesAvailable()) { throw std::invalid_argument{ "Reading more samples than available from BlipBuffer: " + std::to_string(num_samples) }; }
+
+	for (size_t i = 0; i < num_samples; ++i)
+	{
+		integrator_ += buffer_[i];
+		samples[i * stride] = static_cast<float>(integrator_) / kernel_unit_;
+	}
+
+	// Remove the samples read, shifting the rest to the beginning of the buffer
+	std::copy(buffer_.begin() + num_samples, buffer_.end(), buffer_.begin());
+	std::fill(buffer_.end() - num_samples, buffer_.end(), 0);
+	offset_ -= static_cast<uint64_t>(num_samples) << time_bits_;
+}
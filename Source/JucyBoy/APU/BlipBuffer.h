@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Band-limited step synthesis: converts a signal given as amplitude deltas (steps) at input clock timestamps into samples at the output sample rate.
+// Each step is added as a band-limited step (a windowed sinc impulse, integrated when samples are read), so that the output has no aliasing.
+// Time is split into frames: deltas are added with timestamps relative to the start of the current frame, and ending a frame makes its samples available.
+class BlipBuffer final
+{
+public:
+	BlipBuffer() = default;
+	~BlipBuffer() = default;
+
+	// The maximum frame duration (in input clock cycles) determines the size of the buffer.
+	// Samples in the buffer are kept, so that rates can be adjusted between frames without glitches.
+	void SetRates(size_t clock_rate, size_t sample_rate, size_t max_frame_duration);
+	void Clear();
+
+	void AddDelta(size_t clock_time, int delta);
+	void EndFrame(size_t frame_duration);
+
+	size_t GetNumSamplesAvailable() const { return static_cast<size_t>(offset_ >> time_bits_); }
+
+	// Reads (and removes) the given number of available samples, which are written every stride floats
+	void ReadSamples(float *samples, size_t num_samples, size_t stride);
+
+	// Steps show up in the output with a delay of half the kernel width, in output samples
+	static constexpr size_t kernel_width_{ 16 };
+
+	// Rates are settings rather than state: SetRates has to be called again after loading (which also makes room for the current ones)
+	template<class Archive>
+	void serialize(Archive &archive)
+	{
+		archive(offset_, integrator_, buffer_);
+	}
+
+private:
+	static constexpr size_t time_bits_{ 32 };
+	static constexpr size_t phase_bits_{ 6 };
+	static constexpr size_t num_phases_{ 1 << phase_bits_ };
+	static constexpr int kernel_unit_{ 1 << 15 };
+
+	uint64_t time_factor_{ 0 };	// Output samples per input clock cycle, in fixed point
+	uint64_t offset_{ 0 };		// Start of the current frame, in output samples (fixed point)
+	int64_t integrator_{ 0 };
+	std::vector<int32_t> buffer_;
+};
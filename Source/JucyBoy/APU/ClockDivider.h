@@ -1,33 +1,35 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
-#include <functional>
 
 class ClockDivider final
 {
 public:
-	ClockDivider(size_t period, std::function<void()> callback) :
+	ClockDivider(size_t period) :
 		period_{ period },
-		input_clock_cycles_left_{ period },
-		callback_{ callback }
+		input_clock_cycles_left_{ period }
 	{
 	}
 
 	~ClockDivider() = default;
 
-	void OnInputClockCyclesLapsed(size_t num_clock_cycles)
+	// Advances in constant time, returning the number of ticks (i.e. output clock cycles) lapsed, for the caller to process them in bulk
+	size_t OnInputClockCyclesLapsed(size_t num_clock_cycles)
 	{
-		for (auto remaining_clock_cycles = num_clock_cycles; remaining_clock_cycles > 0; --remaining_clock_cycles)
+		if (num_clock_cycles < input_clock_cycles_left_)
 		{
-			if (--input_clock_cycles_left_ == 0)
-			{
-				input_clock_cycles_left_ = period_;
-				callback_();
-			}
+			input_clock_cycles_left_ -= num_clock_cycles;
+			return 0;
 		}
+
+		const auto clock_cycles_after_first_tick = num_clock_cycles - input_clock_cycles_left_;
+		input_clock_cycles_left_ = period_ - (clock_cycles_after_first_tick % period_);
+		return 1 + (clock_cycles_after_first_tick / period_);
 	}
 
 	void SetPeriod(size_t period) { period_ = period; }
+	size_t GetInputClockCyclesLeft() const { return input_clock_cycles_left_; }
 
 	void Reset() { input_clock_cycles_left_ = period_; }
 
@@ -40,6 +42,4 @@ public:
 private:
 	size_t period_;
 	size_t input_clock_cycles_left_;
-
-	std::function<void()> callback_;
 };
@@ -1,7 +1,58 @@
 #include "NoiseChannel.h"
+#include <array>
+#include <limits>
 #include <stdexcept>
 #include <string>
 
+namespace
+{
+	constexpr size_t lfsr_width{ 15 };
+
+	size_t ShiftLfsrOnce(size_t lfsr, bool seven_bits_lfsr)
+	{
+		const auto xored_low_bits_value = (lfsr ^ (lfsr >> 1)) & 0x01;
+		lfsr = ((lfsr >> 1) & ~0x4000) | (xored_low_bits_value << 14);
+		if (seven_bits_lfsr)
+		{
+			lfsr = (lfsr & ~0x0040) | (xored_low_bits_value << 6);
+		}
+		return lfsr;
+	}
+
+	// Shifting the LFSR is linear over GF(2): the matrix of a number of shifts is given by the result of shifting each single bit
+	using LfsrMatrix = std::array<size_t, lfsr_width>;
+
+	size_t Multiply(const LfsrMatrix &matrix, size_t lfsr)
+	{
+		size_t result{ 0 };
+		for (size_t bit = 0; bit < lfsr_width; ++bit)
+		{
+			if (((lfsr >> bit) & 0x01) != 0) result ^= matrix[bit];
+		}
+		return result;
+	}
+
+	// Matrices of 2^i shifts, so that any number of shifts is done with one multiplication per bit set in it
+	using LfsrShiftMatrices = std::array<LfsrMatrix, std::numeric_limits<size_t>::digits>;
+
+	LfsrShiftMatrices ComputeLfsrShiftMatrices(bool seven_bits_lfsr)
+	{
+		LfsrShiftMatrices matrices{};
+		for (size_t bit = 0; bit < lfsr_width; ++bit)
+		{
+			matrices[0][bit] = ShiftLfsrOnce(size_t{ 1 } << bit, seven_bits_lfsr);
+		}
+		for (size_t i = 1; i < matrices.size(); ++i)
+		{
+			for (size_t bit = 0; bit < lfsr_width; ++bit)
+			{
+				matrices[i][bit] = Multiply(matrices[i - 1], matrices[i - 1][bit]);
+			}
+		}
+		return matrices;
+	}
+}
+
 size_t NoiseChannel::GetSample() const
 {
 	return enabled_ * (~lfsr_ & 0x01) * envelope_.current_volume;
@@ -16,22 +67,53 @@ void NoiseChannel::OnClockCyclesLapsed(size_t num_clock_cycles)
 {
 	if (!enabled_) return;
 
-	clock_divider_.OnInputClockCyclesLapsed(num_clock_cycles);
+	const auto num_ticks = clock_divider_.OnInputClockCyclesLapsed(num_clock_cycles);
+	if (divisor_left_shift_ >= 14) return;
+
+	// The LFSR does not show in the output while silent
+	if (envelope_.current_volume == 0)
+	{
+		deferred_lfsr_shifts_ += num_ticks;
+		return;
+	}
+
+	ApplyDeferredLfsrShifts();
+	ShiftLfsr(num_ticks);
 }
 
-void NoiseChannel::OnClockDividerTicked()
+size_t NoiseChannel::GetClockCyclesUntilNextTick() const
 {
-	if (!enabled_) return;
-	if (divisor_left_shift_ >= 14) return;
+	return (enabled_ && (envelope_.current_volume != 0)) ? clock_divider_.GetInputClockCyclesLeft() : std::numeric_limits<size_t>::max();
+}
 
-	const auto xored_low_bits_value = (lfsr_ ^ (lfsr_ >> 1)) & 0x01;
-	lfsr_ = ((lfsr_ >> 1) & ~0x4000) | (xored_low_bits_value << 14);
-	if (seven_bits_lfsr_)
+void NoiseChannel::ShiftLfsr(size_t num_shifts)
+{
+	constexpr size_t max_shifts_one_by_one{ 32 };
+	if (num_shifts <= max_shifts_one_by_one)
 	{
-		lfsr_ = (lfsr_ & ~0x0040) | (xored_low_bits_value << 6);
+		for (size_t shift = 0; shift < num_shifts; ++shift)
+		{
+			lfsr_ = ShiftLfsrOnce(lfsr_, seven_bits_lfsr_);
+		}
+		return;
+	}
+
+	static const auto fifteen_bits_lfsr_shift_matrices = ComputeLfsrShiftMatrices(false);
+	static const auto seven_bits_lfsr_shift_matrices = ComputeLfsrShiftMatrices(true);
+	const auto &shift_matrices = seven_bits_lfsr_ ? seven_bits_lfsr_shift_matrices : fifteen_bits_lfsr_shift_matrices;
+
+	for (size_t i = 0; num_shifts != 0; ++i, num_shifts >>= 1)
+	{
+		if ((num_shifts & 0x01) != 0) lfsr_ = Multiply(shift_matrices[i], lfsr_);
 	}
 }
 
+void NoiseChannel::ApplyDeferredLfsrShifts()
+{
+	ShiftLfsr(deferred_lfsr_shifts_);
+	deferred_lfsr_shifts_ = 0;
+}
+
 void NoiseChannel::ClockLengthCounter()
 {
 	if (length_counter_enabled_ && (length_counter_ > 0))
@@ -98,6 +180,9 @@ void NoiseChannel::OnNR42Written(uint8_t value)
 
 void NoiseChannel::OnNR43Written(uint8_t value)
 {
+	// Deferred shifts are done in the LFSR mode they lapsed in
+	ApplyDeferredLfsrShifts();
+
 	uint8_t frequency_divisors_[8]{ 8, 16, 32, 48, 64, 80, 96, 112 };
 	frequency_divisor_ = frequency_divisors_[value & 0x07];
 	divisor_left_shift_ = value >> 4;
@@ -119,6 +204,7 @@ void NoiseChannel::Trigger()
 {
 	clock_divider_.Reset();
 	lfsr_ = 0x7FFF;
+	deferred_lfsr_shifts_ = 0;
 
 	if (length_counter_ == 0)
 	{
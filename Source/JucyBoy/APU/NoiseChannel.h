@@ -10,9 +10,10 @@ public:
 	NoiseChannel() = default;
 	virtual ~NoiseChannel() {}
 
-	// Clock divider
+	// Clock divider. While the channel is silent, its sample cannot change until it is clocked by the frame sequencer or its registers are written,
+	// so that there is no next tick to report. LFSR shifts are not done one by one then, but deferred until the channel is audible again.
 	void OnClockCyclesLapsed(size_t num_clock_cycles);
-	void OnClockDividerTicked();
+	size_t GetClockCyclesUntilNextTick() const;
 
 	// Interface with frame sequencer
 	void ClockLengthCounter();
@@ -33,12 +34,17 @@ public:
 	void Reset();
 	void Disable() { enabled_ = false; }
 
+	template<class Archive>
+	void serialize(Archive &archive);
+
 protected:
 	virtual void Trigger();
 	inline void UpdateClockDividerPeriod() { clock_divider_.SetPeriod(frequency_divisor_ << divisor_left_shift_); }
 
 private:
 	inline bool IsDacOn() const { return (envelope_.initial_volume != 0) || (envelope_.direction == Envelope::Direction::Amplify); }
+	void ShiftLfsr(size_t num_shifts);
+	void ApplyDeferredLfsrShifts();
 
 private:
 	bool enabled_{ false };
@@ -47,6 +53,7 @@ private:
 	bool length_counter_enabled_{ false };
 
 	size_t lfsr_{ 0x7FFF };
+	size_t deferred_lfsr_shifts_{ 0 };
 	uint8_t frequency_divisor_{ 8 };
 	uint8_t divisor_left_shift_{ 0 };
 	bool seven_bits_lfsr_{ false };
@@ -66,5 +73,13 @@ private:
 		uint8_t cycles_left{ 0 };
 	} envelope_;
 
-	ClockDivider clock_divider_{ static_cast<size_t>(frequency_divisor_ << divisor_left_shift_), std::bind(&NoiseChannel::OnClockDividerTicked, this) };
+	ClockDivider clock_divider_{ static_cast<size_t>(frequency_divisor_ << divisor_left_shift_) };
 };
+
+template<class Archive>
+void NoiseChannel::serialize(Archive &archive)
+{
+	archive(enabled_, length_counter_, length_counter_enabled_, lfsr_, deferred_lfsr_shifts_, frequency_divisor_, divisor_left_shift_, seven_bits_lfsr_);
+	archive(envelope_.initial_volume, envelope_.direction, envelope_.period, envelope_.active, envelope_.current_volume, envelope_.cycles_left);
+	archive(clock_divider_);
+}
@@ -1,4 +1,5 @@
 #include "SquareChannel.h"
+#include <limits>
 #include <stdexcept>
 #include <string>
 
@@ -17,12 +18,13 @@ void SquareChannel::OnClockCyclesLapsed(size_t num_clock_cycles)
 {
 	if (!enabled_) return;
 
-	clock_divider_.OnInputClockCyclesLapsed(num_clock_cycles);
+	const auto num_ticks = clock_divider_.OnInputClockCyclesLapsed(num_clock_cycles);
+	duty_cycle_step_ = (duty_cycle_step_ + num_ticks) & 0x07;
 }
 
-void SquareChannel::OnClockDividerTicked()
+size_t SquareChannel::GetClockCyclesUntilNextTick() const
 {
-	duty_cycle_step_ = (duty_cycle_step_ + 1) & 0x07;
+	return (enabled_ && (envelope_.current_volume != 0)) ? clock_divider_.GetInputClockCyclesLeft() : std::numeric_limits<size_t>::max();
 }
 
 void SquareChannel::ClockLengthCounter()
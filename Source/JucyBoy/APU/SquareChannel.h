@@ -9,9 +9,10 @@ public:
 	SquareChannel() = default;
 	virtual ~SquareChannel() {}
 
-	// Clock divider
+	// Clock divider. While the channel is silent, its sample cannot change until it is clocked by the frame sequencer or its registers are written,
+	// so that there is no next tick to report (it is still clocked, in constant time).
 	void OnClockCyclesLapsed(size_t num_clock_cycles);
-	void OnClockDividerTicked();
+	size_t GetClockCyclesUntilNextTick() const;
 
 	// Interface with frame sequencer
 	void ClockLengthCounter();
@@ -68,7 +69,7 @@ private:
 		size_t cycles_left{ 0 };
 	} envelope_;
 
-	ClockDivider clock_divider_{ (2048 - frequency_) * 4, std::bind(&SquareChannel::OnClockDividerTicked, this) };
+	ClockDivider clock_divider_{ (2048 - frequency_) * 4 };
 
 	static constexpr uint8_t duty_cycles_[4]{ 0x01, 0x81, 0x87, 0x7E };
 };
@@ -1,4 +1,5 @@
 #include "WaveChannel.h"
+#include <limits>
 #include <stdexcept>
 
 size_t WaveChannel::GetSample() const
@@ -16,13 +17,18 @@ void WaveChannel::OnClockCyclesLapsed(size_t num_clock_cycles)
 {
 	if (!enabled_) return;
 
-	clock_divider_.OnInputClockCyclesLapsed(num_clock_cycles);
+	const auto num_ticks = clock_divider_.OnInputClockCyclesLapsed(num_clock_cycles);
+	if (num_ticks == 0) return;
+
+	// Only the last sample read matters
+	current_sample_index_ = (current_sample_index_ + num_ticks) & max_sample_index_;
+	sample_buffer_ = wave_table_[current_sample_index_];
 }
 
-void WaveChannel::OnClockDividerTicked()
+size_t WaveChannel::GetClockCyclesUntilNextTick() const
 {
-	current_sample_index_ = (current_sample_index_ + 1) & max_sample_index_;
-	sample_buffer_ = wave_table_[current_sample_index_];
+	// Wave samples are 4 bits wide, so that the channel is muted by the largest shift
+	return (enabled_ && (volume_right_shift_ < 4)) ? clock_divider_.GetInputClockCyclesLeft() : std::numeric_limits<size_t>::max();
 }
 
 void WaveChannel::ClockLengthCounter()
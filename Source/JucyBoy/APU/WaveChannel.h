@@ -10,9 +10,10 @@ public:
 	WaveChannel() = default;
 	virtual ~WaveChannel() {}
 
-	// Clock divider
+	// Clock divider. While the channel is silent, its sample cannot change until it is clocked by the frame sequencer or its registers are written,
+	// so that there is no next tick to report (it is still clocked, in constant time).
 	void OnClockCyclesLapsed(size_t num_clock_cycles);
-	void OnClockDividerTicked();
+	size_t GetClockCyclesUntilNextTick() const;
 
 	// Interface with frame sequencer
 	void ClockLengthCounter();
@@ -36,6 +37,9 @@ public:
 	void Reset();
 	void Disable() { enabled_ = false; }
 
+	template<class Archive>
+	void serialize(Archive &archive);
+
 protected:
 	virtual void Trigger();
 	inline void UpdateClockDividerPeriod() { clock_divider_.SetPeriod((2048 - frequency_) * 2); }
@@ -58,5 +62,12 @@ private:
 	size_t length_counter_{ 0 };
 	bool length_counter_enabled_{ false };
 
-	ClockDivider clock_divider_{ (2048 - frequency_) * 2, std::bind(&WaveChannel::OnClockDividerTicked, this) };
+	ClockDivider clock_divider_{ (2048 - frequency_) * 2 };
 };
+
+template<class Archive>
+void WaveChannel::serialize(Archive &archive)
+{
+	archive(enabled_, is_dac_on_, wave_table_, current_sample_index_, sample_buffer_, frequency_, volume_right_shift_, length_counter_, length_counter_enabled_);
+	archive(clock_divider_);
+}
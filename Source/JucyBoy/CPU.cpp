@@ -2,9 +2,14 @@
 #include <cassert>
 #include <string>
 
-CPU::CPU(MMU &mmu) :
-	mmu_{ &mmu }
+CPU::CPU(MMU &mmu, Scheduler &scheduler) :
+	mmu_{ &mmu },
+	scheduler_{ &scheduler }
 {
+#if JUCYBOY_CPU_DISPATCH == JUCYBOY_CPU_DISPATCH_BLOCK_CACHE
+	decoded_block_lookup_.resize(std::numeric_limits<Memory::Address>::max() + 1);
+	mmu.AddCodePageWriteListener([this](Memory::Address address) { OnCodePageWritten(address); });
+#endif
 }
 
 CPU::~CPU()
@@ -28,7 +33,7 @@ void CPU::Run()
 {
 	if (loop_function_result_.valid()) { return; }
 
-	exit_loop_.store(false);
+	ResetRunningLoop();
 	loop_function_result_ = std::async(std::launch::async, &CPU::RunningLoopFunction, this);
 }
 
@@ -36,6 +41,7 @@ void CPU::Stop()
 {
 	if (!loop_function_result_.valid()) { return; }
 
+	stop_requested_.store(true);
 	exit_loop_.store(true);
 	
 	// Note: the following bug has been found in Visual Studio (including VS2015)
@@ -60,19 +66,70 @@ bool CPU::IsRunning() const noexcept
 	return loop_function_result_.valid();
 }
 
+void CPU::RunInCallingThread()
+{
+	if (IsRunning()) { throw std::logic_error{ "Trying to call RunInCallingThread while RunningLoopFunction thread is running" }; }
+
+	ResetRunningLoop();
+	RunningLoopFunction();
+}
+
+void CPU::InterruptRun()
+{
+	stop_requested_.store(true);
+	exit_loop_.store(true);
+}
+
+void CPU::RequestSafePoint()
+{
+	safe_point_requested_.store(true);
+	exit_loop_.store(true);
+}
+
+void CPU::ResetRunningLoop()
+{
+	stop_requested_.store(false);
+	safe_point_requested_.store(false);
+	exit_loop_.store(false);
+}
+
+bool CPU::ContinueRunningLoop()
+{
+	// A safe point requested right before stopping is still honored
+	if (safe_point_requested_.exchange(false) && safe_point_function_) safe_point_function_();
+
+	if (stop_requested_.load()) return false;
+
+	// Stop may be called meanwhile from another thread: checking again after resetting the exit flag ensures that it is not missed
+	exit_loop_.store(false);
+	return !stop_requested_.load();
+}
+
 void CPU::RunningLoopFunction()
 {
 	try
 	{
 		//TODO: only check exit_loop_ once per frame (during VBlank), in order to increase performance
 		//TODO: precompute the next breakpoint instead of iterating the whole set every time. This "next breakpoint" would need to be updated after every Jump instruction.
-		while (!exit_loop_.load())
+		do
 		{
-			ExecuteOneInstruction();
-		}
+			while (!exit_loop_.load())
+			{
+#if JUCYBOY_CPU_DISPATCH == JUCYBOY_CPU_DISPATCH_THREADED
+				ExecuteThreadedInstructions();
+#elif JUCYBOY_CPU_DISPATCH == JUCYBOY_CPU_DISPATCH_BLOCK_CACHE
+				ExecuteDecodedBlock();
+#else
+				ExecuteOneInstruction();
+#endif
+			}
+		} while (ContinueRunningLoop());
 	}
 	catch (std::exception &)
 	{
+#if JUCYBOY_CPU_DISPATCH == JUCYBOY_CPU_DISPATCH_BLOCK_CACHE
+		decoded_operands_ = nullptr;
+#endif
 		NotifyRunningLoopInterruption();
 
 		// Rethrow the exception that was just caught, in order to retrieve it later via future::get()
@@ -97,17 +154,18 @@ void CPU::ExecuteOneInstruction()
 	{
 	case State::Running:
 		previous_pc_ = registers_.pc;
-		ExecuteInstruction(FetchByte());
+		DispatchInstruction(FetchByte());
 		break;
 	case State::Halted:
-		// NOP instructions are executed until Halted state ends
-		NotifyMachineCycleLapse();
+		// NOP instructions are executed until Halted state ends.
+		// Since only the components' events can end Halted state, fast-forward until the next one is due.
+		scheduler_->OnMachineCyclesLapsed(scheduler_->GetMachineCyclesUntilNextEvent());
 		break;
 	case State::HaltBug:
 		// PC increment is skipped once when fetching the next opcode (no extra cycles are lapsed)
 		current_state_ = State::Running;
 		previous_pc_ = registers_.pc;
-		ExecuteInstruction(mmu_->ReadByte(registers_.pc));
+		DispatchInstruction(mmu_->ReadByte(registers_.pc));
 		break;
 	case State::Stopped:
 		//TODO check for joypad input, since that is the only thing that can finish Stopped state
@@ -434,12 +492,6 @@ void CPU::NotifyRunningLoopInterruption() const
 	}
 }
 
-std::function<void()> CPU::AddMachineCycleLapseListener(std::function<void()> &&listener)
-{
-	auto it = machine_cycle_lapse_listeners_.emplace(machine_cycle_lapse_listeners_.begin(), listener);
-	return [it, this]() { machine_cycle_lapse_listeners_.erase(it); };
-}
-
 std::function<void()> CPU::AddRunningLoopInterruptionListener(std::function<void()> &&listener)
 {
 	auto it = running_loop_interruption_listeners_.emplace(running_loop_interruption_listeners_.begin(), listener);
@@ -5,9 +5,35 @@
 #include <atomic>
 #include <future>
 #include <list>
+#include <utility>
+#include <vector>
+#include <unordered_map>
 #include "Registers.h"
 #include "Memory.h"
 #include "MMU.h"
+#include "Scheduler.h"
+
+// Instruction dispatch engine, selected at build time by defining JUCYBOY_CPU_DISPATCH as one of these:
+//   SWITCH:   the switch statements in ExecuteInstruction and ExecuteCbInstruction
+//   TABLE:    a table of handler functions generated at compile time (switch only used for irregular opcodes)
+//   THREADED: the same table, plus computed-goto threading in the running loop (GCC/Clang only)
+//   BLOCK_CACHE: the same table, plus a cache of decoded basic blocks executed by the running loop
+#define JUCYBOY_CPU_DISPATCH_SWITCH 0
+#define JUCYBOY_CPU_DISPATCH_TABLE 1
+#define JUCYBOY_CPU_DISPATCH_THREADED 2
+#define JUCYBOY_CPU_DISPATCH_BLOCK_CACHE 3
+
+#ifndef JUCYBOY_CPU_DISPATCH
+#if defined(__GNUC__) || defined(__clang__)
+#define JUCYBOY_CPU_DISPATCH JUCYBOY_CPU_DISPATCH_THREADED
+#else
+#define JUCYBOY_CPU_DISPATCH JUCYBOY_CPU_DISPATCH_TABLE
+#endif
+#endif
+
+#if (JUCYBOY_CPU_DISPATCH == JUCYBOY_CPU_DISPATCH_THREADED) && !(defined(__GNUC__) || defined(__clang__))
+#error "Threaded CPU dispatch requires computed goto support (GCC/Clang)"
+#endif
 
 class CPU
 {
@@ -35,7 +61,7 @@ public:
 	};
 
 public:
-	CPU(MMU &mmu);
+	CPU(MMU &mmu, Scheduler &scheduler);
 	virtual ~CPU();
 
 	// Set initial state of registers_
@@ -47,6 +73,15 @@ public:
 	bool IsRunning() const noexcept;
 	void StepOver();
 
+	// Synchronous alternative to Run/Stop: runs in the calling thread until InterruptRun is called (e.g. from a scheduler callback)
+	void RunInCallingThread();
+	void InterruptRun();
+
+	// Safe points: the running loop calls the safe point function right after the current instruction, and then carries on running.
+	// No component is being synchronized at that point, so that the whole machine state can be saved or replaced from it.
+	void RequestSafePoint();
+	void SetSafePointFunction(std::function<void()> &&safe_point_function) { safe_point_function_ = std::move(safe_point_function); }
+
 	// MMU mapped memory read/write functions
 	uint8_t OnIoMemoryRead(Memory::Address address) const;
 	void OnIoMemoryWritten(Memory::Address address, uint8_t value);
@@ -54,7 +89,6 @@ public:
 	void OnInterruptsWritten(Memory::Address address, uint8_t value);
 
 	// Listeners management
-	std::function<void()> AddMachineCycleLapseListener(std::function<void()> &&listener);
 	std::function<void()> AddRunningLoopInterruptionListener(std::function<void()> &&listener);
 
 	template<class Archive>
@@ -66,6 +100,10 @@ protected:
 	// Listener notification
 	void NotifyRunningLoopInterruption() const;
 
+	// Running loop control: to be called when the instruction loop is exited, returning whether to enter it again (i.e. when exited only for a safe point)
+	void ResetRunningLoop();
+	bool ContinueRunningLoop();
+
 	Flags ReadFlags() const;
 
 private:
@@ -74,13 +112,83 @@ private:
 	void ExecuteCbInstruction(OpCode opcode);
 	void RunningLoopFunction();
 
+	// Instruction dispatch (see CPU_InstructionTable.cpp)
+	using InstructionHandler = void (CPU::*)(OpCode opcode);
+#if JUCYBOY_CPU_DISPATCH == JUCYBOY_CPU_DISPATCH_SWITCH
+	inline void DispatchInstruction(OpCode opcode) { ExecuteInstruction(opcode); }
+#else
+	inline void DispatchInstruction(OpCode opcode) { (this->*instruction_table_[opcode])(opcode); }
+#endif
+#if JUCYBOY_CPU_DISPATCH == JUCYBOY_CPU_DISPATCH_THREADED
+	void ExecuteThreadedInstructions();
+#endif
+	void ExecuteCbPrefixInstruction(OpCode opcode);
+
+#if JUCYBOY_CPU_DISPATCH == JUCYBOY_CPU_DISPATCH_BLOCK_CACHE
+	// Decoded basic blocks (see CPU_BlockCache.cpp)
+	struct DecodedInstruction
+	{
+		InstructionHandler handler{ nullptr };
+		OpCode opcode{ 0 }; // Second opcode for CB-prefixed instructions
+		uint8_t num_opcode_bytes{ 0 };
+		uint8_t size{ 0 };
+		std::array<uint8_t, 2> operands{};
+	};
+
+	struct DecodedBlock
+	{
+		Memory::Address address{ 0 };
+		const uint8_t *code{ nullptr };
+		std::vector<DecodedInstruction> instructions;
+	};
+
+	struct DecodedBlockLookup
+	{
+		const DecodedBlock *block{ nullptr };
+		uint64_t mapping_generation{ 0 }; // MMU mapping generation when the block was last known to be mapped at its address
+	};
+
+	void ExecuteDecodedBlock();
+	const DecodedBlock* GetDecodedBlock(Memory::Address address);
+	DecodedBlock DecodeBlock(Memory::Address address, const uint8_t *code) const;
+	void OnCodePageWritten(Memory::Address address);
+	void InvalidateDecodedBlocks();
+#endif
+
+	// Instruction handlers for the regular opcode blocks.
+	// Operands are encoded as in the opcodes: 0 = B, 1 = C, 2 = D, 3 = E, 4 = H, 5 = L, 6 = (HL), 7 = A
+	template<size_t Operand> uint8_t ReadOperand();
+	template<size_t Operand> void WriteOperand(uint8_t value);
+	template<size_t Destination, size_t Source> void LoadInstruction(OpCode opcode);
+	template<size_t Destination> void LoadImmediateInstruction(OpCode opcode);
+	template<size_t Operand> void IncrementInstruction(OpCode opcode);
+	template<size_t Operand> void DecrementInstruction(OpCode opcode);
+	template<size_t Operation, size_t Source> void ArithmeticLogicInstruction(OpCode opcode);
+	template<size_t Operation, size_t Operand> void RotateShiftInstruction(OpCode opcode);
+	template<size_t Bit, size_t Operand> void TestBitInstruction(OpCode opcode);
+	template<size_t Bit, size_t Operand> void ResetBitInstruction(OpCode opcode);
+	template<size_t Bit, size_t Operand> void SetBitInstruction(OpCode opcode);
+
+	template<size_t Opcode> static constexpr InstructionHandler GetInstructionHandler();
+	template<size_t Opcode> static constexpr InstructionHandler GetCbInstructionHandler();
+	template<size_t... Opcodes> static constexpr std::array<InstructionHandler, 256> MakeInstructionTable(std::index_sequence<Opcodes...>);
+	template<size_t... Opcodes> static constexpr std::array<InstructionHandler, 256> MakeCbInstructionTable(std::index_sequence<Opcodes...>);
+
+	static const std::array<InstructionHandler, 256> instruction_table_;
+	static const std::array<InstructionHandler, 256> cb_instruction_table_;
+
 	// Interrupts
 	void CheckInterrupts();
 
 	// Memory R/W
 	inline uint8_t ReadByte(Memory::Address address) const { NotifyMachineCycleLapse(); return mmu_->ReadByte(address); }
 	inline void WriteByte(Memory::Address address, uint8_t value) const { NotifyMachineCycleLapse(); mmu_->WriteByte(address, value); }
+#if JUCYBOY_CPU_DISPATCH == JUCYBOY_CPU_DISPATCH_BLOCK_CACHE
+	// Operands of decoded instructions are not read again, although their machine cycles still lapse
+	inline uint8_t FetchByte() { if (decoded_operands_ == nullptr) { return ReadByte(registers_.pc++); } NotifyMachineCycleLapse(); ++registers_.pc; return *decoded_operands_++; }
+#else
 	inline uint8_t FetchByte() { return ReadByte(registers_.pc++); }
+#endif
 	uint16_t FetchWord();
 	uint16_t PopWordFromStack();
 	void PushWordToStack(uint16_t value);
@@ -117,16 +225,20 @@ private:
 	void ToggleFlag(Flags flag);
 	bool IsFlagSet(Flags flag) const;
 
-	// Listener notification
-	inline void CPU::NotifyMachineCycleLapse() const { for (auto& listener : machine_cycle_lapse_listeners_) { listener(); } }
+	// Scheduler notification
+	inline void NotifyMachineCycleLapse() const { scheduler_->OnMachineCycleLapse(); }
 
 protected:
 	Registers registers_;
 
-	std::atomic<bool> exit_loop_{ false };
+	std::atomic<bool> exit_loop_{ false };			// Exits the instruction loop...
+	std::atomic<bool> stop_requested_{ false };		// ...for good
+	std::atomic<bool> safe_point_requested_{ false };	// ...just for a safe point
+	std::function<void()> safe_point_function_;
 	std::future<void> loop_function_result_;
 
 	MMU *mmu_{ nullptr };
+	Scheduler *scheduler_{ nullptr };
 
 private:
 	enum class Interrupt
@@ -155,9 +267,21 @@ private:
 	uint8_t enabled_interrupts_{ 0 };
 	uint8_t requested_interrupts_{ 0 };
 
-	std::list<std::function<void()>> machine_cycle_lapse_listeners_;
 	std::list<std::function<void()>> running_loop_interruption_listeners_;
 
+#if JUCYBOY_CPU_DISPATCH == JUCYBOY_CPU_DISPATCH_BLOCK_CACHE
+	// Blocks are keyed by the host memory they were decoded from, which identifies the ROM bank (or RAM page) besides the address
+	std::unordered_map<const uint8_t*, DecodedBlock> decoded_blocks_;
+	std::vector<DecodedBlockLookup> decoded_block_lookup_; // Last block executed at each address
+	std::array<std::vector<const uint8_t*>, 0x100> decoded_ram_blocks_by_page_;
+
+	// RAM pages whose code keeps being overwritten (e.g. code mixed with variables) are not worth caching
+	static constexpr uint8_t max_code_page_invalidations_{ 16 };
+	std::array<uint8_t, 0x100> code_page_invalidations_{};
+
+	const uint8_t *decoded_operands_{ nullptr };
+#endif
+
 private:
 	CPU(const CPU&) = delete;
 	CPU(CPU&&) = delete;
@@ -198,4 +322,9 @@ void CPU::serialize(Archive & archive)
 {
 	archive(registers_.af, registers_.bc, registers_.de, registers_.hl, registers_.pc, registers_.sp);
 	archive(previous_pc_, current_state_, interrupt_master_enable_, ime_requested_, enabled_interrupts_, requested_interrupts_);
+
+#if JUCYBOY_CPU_DISPATCH == JUCYBOY_CPU_DISPATCH_BLOCK_CACHE
+	// Memory is about to be overwritten when loading
+	if (Archive::is_loading::value) InvalidateDecodedBlocks();
+#endif
 }
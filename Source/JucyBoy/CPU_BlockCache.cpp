@@ -0,0 +1,205 @@
+#include "CPU.h"
+#include "MMU.h"
+#include <algorithm>
+
+#if JUCYBOY_CPU_DISPATCH == JUCYBOY_CPU_DISPATCH_BLOCK_CACHE
+namespace
+{
+	// Opcode plus operands, in bytes
+	constexpr uint8_t GetInstructionSize(CPU::OpCode opcode)
+	{
+		switch (opcode)
+		{
+		case 0x01: case 0x08: case 0x11: case 0x21: case 0x31: // LD rr, d16 / LD (a16), SP
+		case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA: // JP a16
+		case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC: // CALL a16
+		case 0xEA: case 0xFA: // LD (a16), A / LD A, (a16)
+			return 3;
+		case 0x06: case 0x0E: case 0x16: case 0x1E: case 0x26: case 0x2E: case 0x36: case 0x3E: // LD r, d8
+		case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: // JR r8
+		case 0xC6: case 0xCE: case 0xD6: case 0xDE: case 0xE6: case 0xEE: case 0xF6: case 0xFE: // ALU d8
+		case 0xE0: case 0xF0: // LDH
+		case 0xE8: case 0xF8: // ADD SP, r8 / LD HL, SP+r8
+		case 0xCB: // Prefix
+			return 2;
+		default:
+			return 1;
+		}
+	}
+
+	// Instructions that may change the program flow or the CPU state
+	constexpr bool IsBlockTerminator(CPU::OpCode opcode)
+	{
+		switch (opcode)
+		{
+		case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: // JR
+		case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA: case 0xE9: // JP
+		case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC: // CALL
+		case 0xC0: case 0xC8: case 0xC9: case 0xD0: case 0xD8: case 0xD9: // RET / RETI
+		case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF: // RST
+		case 0x10: case 0x76: case 0xF3: case 0xFB: // STOP / HALT / DI / EI
+			return true;
+		default:
+			return false;
+		}
+	}
+}
+
+void CPU::ExecuteDecodedBlock()
+{
+	const auto block = (current_state_ == State::Running) ? GetDecodedBlock(registers_.pc) : nullptr;
+	if (block == nullptr)
+	{
+		ExecuteOneInstruction();
+		return;
+	}
+
+	// Writing to a watched code page, or switching ROM banks, may change the remaining instructions (or even destroy the block).
+	// Neither the block nor its instructions are accessed again after that.
+	const auto mapping_generation = mmu_->GetMappingGeneration();
+	const auto *instruction = block->instructions.data();
+	const auto *const instructions_end = instruction + block->instructions.size();
+
+	for (; instruction != instructions_end; ++instruction)
+	{
+		previous_pc_ = registers_.pc;
+		const auto next_pc = static_cast<Memory::Address>(registers_.pc + instruction->size);
+
+		// The opcode fetches still lapse their machine cycles
+		for (auto i = 0; i < instruction->num_opcode_bytes; ++i)
+		{
+			NotifyMachineCycleLapse();
+		}
+		registers_.pc += instruction->num_opcode_bytes;
+
+		decoded_operands_ = instruction->operands.data();
+		(this->*instruction->handler)(instruction->opcode);
+		decoded_operands_ = nullptr;
+
+		CheckInterrupts();
+
+		// Leave the block if an interrupt was serviced, a branch was taken, the CPU halted, or the code may have changed
+		if ((registers_.pc != next_pc) || (current_state_ != State::Running) || (mmu_->GetMappingGeneration() != mapping_generation)) { return; }
+	}
+}
+
+const CPU::DecodedBlock* CPU::GetDecodedBlock(Memory::Address address)
+{
+	// The last block executed at this address is still valid as long as the memory mapping has not changed
+	auto &lookup = decoded_block_lookup_[address];
+	const auto mapping_generation = mmu_->GetMappingGeneration();
+	if ((lookup.block != nullptr) && (lookup.mapping_generation == mapping_generation)) { return lookup.block; }
+
+	const auto code = mmu_->GetCodePointer(address);
+	if (code == nullptr) { return nullptr; }
+
+	if ((lookup.block != nullptr) && (lookup.block->code == code))
+	{
+		lookup.mapping_generation = mapping_generation;
+		return lookup.block;
+	}
+
+	auto it = decoded_blocks_.find(code);
+	if ((it == decoded_blocks_.end()) || (it->second.address != address))
+	{
+		const auto is_ram = (address >= Memory::wram_offset_);
+		const auto page = address >> 8;
+		if (is_ram)
+		{
+			if (code_page_invalidations_[page] >= max_code_page_invalidations_) { return nullptr; }
+			mmu_->WatchCodePage(address);
+		}
+
+		auto block = DecodeBlock(address, code);
+		if (block.instructions.empty()) { return nullptr; }
+
+		if (it != decoded_blocks_.end())
+		{
+			// Same memory, mapped at a different address (e.g. a ROM bank mapped in both ROM regions)
+			if (decoded_block_lookup_[it->second.address].block == &it->second) { decoded_block_lookup_[it->second.address].block = nullptr; }
+			it->second = std::move(block);
+		}
+		else
+		{
+			it = decoded_blocks_.emplace(code, std::move(block)).first;
+			if (is_ram) { decoded_ram_blocks_by_page_[page].push_back(code); }
+		}
+	}
+
+	lookup.block = &it->second;
+	lookup.mapping_generation = mapping_generation;
+	return lookup.block;
+}
+
+CPU::DecodedBlock CPU::DecodeBlock(Memory::Address address, const uint8_t *code) const
+{
+	DecodedBlock block;
+	block.address = address;
+	block.code = code;
+
+	// Blocks never cross a page boundary, since the next page may be a different ROM bank (or RAM page).
+	// The last page also contains IE, right after HRAM.
+	const auto page_end = (address & ~(MMU::page_size_ - 1)) + MMU::page_size_;
+	const auto code_end = (address >= Memory::hram_offset_) ? Memory::interrupts_offset_ : page_end;
+	const auto code_size = static_cast<size_t>(code_end - address);
+
+	for (size_t offset = 0; offset < code_size;)
+	{
+		const auto opcode = code[offset];
+
+		DecodedInstruction instruction;
+		instruction.size = GetInstructionSize(opcode);
+		if ((offset + instruction.size) > code_size) { break; }
+
+		if (opcode == 0xCB)
+		{
+			instruction.opcode = code[offset + 1];
+			instruction.handler = cb_instruction_table_[instruction.opcode];
+			instruction.num_opcode_bytes = 2;
+		}
+		else
+		{
+			instruction.opcode = opcode;
+			instruction.handler = instruction_table_[opcode];
+			instruction.num_opcode_bytes = 1;
+			for (auto i = 1; i < instruction.size; ++i)
+			{
+				instruction.operands[i - 1] = code[offset + i];
+			}
+		}
+
+		block.instructions.push_back(instruction);
+		offset += instruction.size;
+
+		if (IsBlockTerminator(opcode)) { break; }
+	}
+
+	return block;
+}
+
+void CPU::OnCodePageWritten(Memory::Address address)
+{
+	const auto page = address >> 8;
+	if (code_page_invalidations_[page] < max_code_page_invalidations_) { ++code_page_invalidations_[page]; }
+
+	for (const auto code : decoded_ram_blocks_by_page_[page])
+	{
+		const auto it = decoded_blocks_.find(code);
+		if (it == decoded_blocks_.end()) { continue; }
+
+		if (decoded_block_lookup_[it->second.address].block == &it->second) { decoded_block_lookup_[it->second.address].block = nullptr; }
+		decoded_blocks_.erase(it);
+	}
+	decoded_ram_blocks_by_page_[page].clear();
+}
+
+void CPU::InvalidateDecodedBlocks()
+{
+	decoded_blocks_.clear();
+	std::fill(decoded_block_lookup_.begin(), decoded_block_lookup_.end(), DecodedBlockLookup{});
+	for (auto &page_blocks : decoded_ram_blocks_by_page_)
+	{
+		page_blocks.clear();
+	}
+}
+#endif
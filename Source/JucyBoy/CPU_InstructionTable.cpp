@@ -0,0 +1,229 @@
+#include "CPU.h"
+#include "MMU.h"
+
+#pragma region Operand access
+template<size_t Operand>
+uint8_t CPU::ReadOperand()
+{
+	static_assert(Operand < 8, "Invalid operand");
+
+	switch (Operand)
+	{
+	case 0: return registers_.bc.High();
+	case 1: return registers_.bc.Low();
+	case 2: return registers_.de.High();
+	case 3: return registers_.de.Low();
+	case 4: return registers_.hl.High();
+	case 5: return registers_.hl.Low();
+	case 6: return ReadByte(registers_.hl);
+	default: return registers_.af.High();
+	}
+}
+
+template<size_t Operand>
+void CPU::WriteOperand(uint8_t value)
+{
+	static_assert(Operand < 8, "Invalid operand");
+
+	switch (Operand)
+	{
+	case 0: registers_.bc.High() = value; break;
+	case 1: registers_.bc.Low() = value; break;
+	case 2: registers_.de.High() = value; break;
+	case 3: registers_.de.Low() = value; break;
+	case 4: registers_.hl.High() = value; break;
+	case 5: registers_.hl.Low() = value; break;
+	case 6: WriteByte(registers_.hl, value); break;
+	default: registers_.af.High() = value; break;
+	}
+}
+#pragma endregion
+
+#pragma region Instruction handlers
+// LD r, r' (0x40 - 0x7F, except HALT)
+template<size_t Destination, size_t Source>
+void CPU::LoadInstruction(OpCode /*opcode*/)
+{
+	WriteOperand<Destination>(ReadOperand<Source>());
+}
+
+// LD r, d8
+template<size_t Destination>
+void CPU::LoadImmediateInstruction(OpCode /*opcode*/)
+{
+	WriteOperand<Destination>(FetchByte());
+}
+
+// INC r
+template<size_t Operand>
+void CPU::IncrementInstruction(OpCode /*opcode*/)
+{
+	WriteOperand<Operand>(IncrementRegister(ReadOperand<Operand>()));
+}
+
+// DEC r
+template<size_t Operand>
+void CPU::DecrementInstruction(OpCode /*opcode*/)
+{
+	WriteOperand<Operand>(DecrementRegister(ReadOperand<Operand>()));
+}
+
+// ADD, ADC, SUB, SBC, AND, XOR, OR, CP (0x80 - 0xBF)
+template<size_t Operation, size_t Source>
+void CPU::ArithmeticLogicInstruction(OpCode /*opcode*/)
+{
+	const auto value = ReadOperand<Source>();
+
+	switch (Operation)
+	{
+	case 0: Add(value); break;
+	case 1: Adc(value); break;
+	case 2: Sub(value); break;
+	case 3: Sbc(value); break;
+	case 4: And(value); break;
+	case 5: Xor(value); break;
+	case 6: Or(value); break;
+	default: Compare(value); break;
+	}
+}
+
+// RLC, RRC, RL, RR, SLA, SRA, SWAP, SRL (CB 0x00 - 0x3F)
+template<size_t Operation, size_t Operand>
+void CPU::RotateShiftInstruction(OpCode /*opcode*/)
+{
+	const auto value = ReadOperand<Operand>();
+
+	switch (Operation)
+	{
+	case 0: WriteOperand<Operand>(Rlc(value)); break;
+	case 1: WriteOperand<Operand>(Rrc(value)); break;
+	case 2: WriteOperand<Operand>(Rl(value)); break;
+	case 3: WriteOperand<Operand>(Rr(value)); break;
+	case 4: WriteOperand<Operand>(Sla(value)); break;
+	case 5: WriteOperand<Operand>(Sra(value)); break;
+	case 6: WriteOperand<Operand>(Swap(value)); break;
+	default: WriteOperand<Operand>(Srl(value)); break;
+	}
+}
+
+// BIT b, r (CB 0x40 - 0x7F)
+template<size_t Bit, size_t Operand>
+void CPU::TestBitInstruction(OpCode /*opcode*/)
+{
+	Test(ReadOperand<Operand>(), 1 << Bit);
+}
+
+// RES b, r (CB 0x80 - 0xBF)
+template<size_t Bit, size_t Operand>
+void CPU::ResetBitInstruction(OpCode /*opcode*/)
+{
+	WriteOperand<Operand>(static_cast<uint8_t>(ReadOperand<Operand>() & ~(1 << Bit)));
+}
+
+// SET b, r (CB 0xC0 - 0xFF)
+template<size_t Bit, size_t Operand>
+void CPU::SetBitInstruction(OpCode /*opcode*/)
+{
+	WriteOperand<Operand>(static_cast<uint8_t>(ReadOperand<Operand>() | (1 << Bit)));
+}
+
+void CPU::ExecuteCbPrefixInstruction(OpCode /*opcode*/)
+{
+	const auto cb_opcode = FetchByte();
+	(this->*cb_instruction_table_[cb_opcode])(cb_opcode);
+}
+#pragma endregion
+
+#pragma region Instruction tables
+template<size_t Opcode>
+constexpr CPU::InstructionHandler CPU::GetInstructionHandler()
+{
+	constexpr size_t operand_x = (Opcode >> 3) & 0x07;
+	constexpr size_t operand_y = Opcode & 0x07;
+
+	if constexpr ((Opcode >= 0x40) && (Opcode < 0x80) && (Opcode != 0x76)) return &CPU::LoadInstruction<operand_x, operand_y>;
+	else if constexpr ((Opcode >= 0x80) && (Opcode < 0xC0)) return &CPU::ArithmeticLogicInstruction<operand_x, operand_y>;
+	else if constexpr ((Opcode < 0x40) && (operand_y == 4)) return &CPU::IncrementInstruction<operand_x>;
+	else if constexpr ((Opcode < 0x40) && (operand_y == 5)) return &CPU::DecrementInstruction<operand_x>;
+	else if constexpr ((Opcode < 0x40) && (operand_y == 6)) return &CPU::LoadImmediateInstruction<operand_x>;
+	else if constexpr (Opcode == 0xCB) return &CPU::ExecuteCbPrefixInstruction;
+	else return &CPU::ExecuteInstruction; // Irregular opcodes are still executed by the switch statement
+}
+
+template<size_t Opcode>
+constexpr CPU::InstructionHandler CPU::GetCbInstructionHandler()
+{
+	constexpr size_t operation = (Opcode >> 3) & 0x07;
+	constexpr size_t operand = Opcode & 0x07;
+
+	if constexpr (Opcode < 0x40) return &CPU::RotateShiftInstruction<operation, operand>;
+	else if constexpr (Opcode < 0x80) return &CPU::TestBitInstruction<operation, operand>;
+	else if constexpr (Opcode < 0xC0) return &CPU::ResetBitInstruction<operation, operand>;
+	else return &CPU::SetBitInstruction<operation, operand>;
+}
+
+template<size_t... Opcodes>
+constexpr std::array<CPU::InstructionHandler, 256> CPU::MakeInstructionTable(std::index_sequence<Opcodes...>)
+{
+	return{ { GetInstructionHandler<Opcodes>()... } };
+}
+
+template<size_t... Opcodes>
+constexpr std::array<CPU::InstructionHandler, 256> CPU::MakeCbInstructionTable(std::index_sequence<Opcodes...>)
+{
+	return{ { GetCbInstructionHandler<Opcodes>()... } };
+}
+
+constexpr std::array<CPU::InstructionHandler, 256> CPU::instruction_table_{ CPU::MakeInstructionTable(std::make_index_sequence<256>{}) };
+constexpr std::array<CPU::InstructionHandler, 256> CPU::cb_instruction_table_{ CPU::MakeCbInstructionTable(std::make_index_sequence<256>{}) };
+#pragma endregion
+
+#pragma region Threaded dispatch
+#if JUCYBOY_CPU_DISPATCH == JUCYBOY_CPU_DISPATCH_THREADED
+#define JUCYBOY_OPCODE_ROW(X, high) X(high, 0) X(high, 1) X(high, 2) X(high, 3) X(high, 4) X(high, 5) X(high, 6) X(high, 7) \
+	X(high, 8) X(high, 9) X(high, A) X(high, B) X(high, C) X(high, D) X(high, E) X(high, F)
+#define JUCYBOY_FOR_EACH_OPCODE(X) JUCYBOY_OPCODE_ROW(X, 0) JUCYBOY_OPCODE_ROW(X, 1) JUCYBOY_OPCODE_ROW(X, 2) JUCYBOY_OPCODE_ROW(X, 3) \
+	JUCYBOY_OPCODE_ROW(X, 4) JUCYBOY_OPCODE_ROW(X, 5) JUCYBOY_OPCODE_ROW(X, 6) JUCYBOY_OPCODE_ROW(X, 7) \
+	JUCYBOY_OPCODE_ROW(X, 8) JUCYBOY_OPCODE_ROW(X, 9) JUCYBOY_OPCODE_ROW(X, A) JUCYBOY_OPCODE_ROW(X, B) \
+	JUCYBOY_OPCODE_ROW(X, C) JUCYBOY_OPCODE_ROW(X, D) JUCYBOY_OPCODE_ROW(X, E) JUCYBOY_OPCODE_ROW(X, F)
+
+void CPU::ExecuteThreadedInstructions()
+{
+	// Every opcode has its own label, which ends with its own indirect jump to the next instruction.
+	// This way, the branch predictor can learn the most likely successor of each opcode, instead of sharing a single jump for all of them.
+#define JUCYBOY_OPCODE_LABEL_ADDRESS(high, low) &&opcode_##high##low,
+	static void* const opcode_labels[256]{ JUCYBOY_FOR_EACH_OPCODE(JUCYBOY_OPCODE_LABEL_ADDRESS) };
+#undef JUCYBOY_OPCODE_LABEL_ADDRESS
+
+	// Only the Running state is threaded: Halted/HaltBug/Stopped states are left to ExecuteOneInstruction
+#define JUCYBOY_DISPATCH_NEXT_INSTRUCTION() \
+	if ((current_state_ != State::Running) || exit_loop_.load(std::memory_order_relaxed)) return; \
+	previous_pc_ = registers_.pc; \
+	opcode = FetchByte(); \
+	goto *opcode_labels[opcode]
+
+	if (current_state_ != State::Running)
+	{
+		ExecuteOneInstruction();
+		return;
+	}
+
+	OpCode opcode{ 0 };
+	JUCYBOY_DISPATCH_NEXT_INSTRUCTION();
+
+#define JUCYBOY_OPCODE_HANDLER(high, low) \
+	opcode_##high##low: \
+	(this->*instruction_table_[0x##high##low])(0x##high##low); \
+	CheckInterrupts(); \
+	JUCYBOY_DISPATCH_NEXT_INSTRUCTION();
+
+	JUCYBOY_FOR_EACH_OPCODE(JUCYBOY_OPCODE_HANDLER)
+
+#undef JUCYBOY_OPCODE_HANDLER
+#undef JUCYBOY_DISPATCH_NEXT_INSTRUCTION
+}
+
+#undef JUCYBOY_FOR_EACH_OPCODE
+#undef JUCYBOY_OPCODE_ROW
+#endif
+#pragma endregion
@@ -1,38 +1,30 @@
 #include "Cartridge.h"
+#include "MMU.h"
 #include <cassert>
 #include <fstream>
-#include <array>
 
-Cartridge::Cartridge(const std::string &rom_file_path)
+Cartridge::Cartridge(MMU &mmu, const std::string &rom_file_path) :
+	mmu_{ &mmu }
 {
-	std::ifstream rom_read_stream{ rom_file_path, std::ios::binary | std::ios::ate };
-	if (!rom_read_stream.is_open()) { throw std::runtime_error{ "ROM file could not be opened" }; }
+	rom_image_ = RomImage::Open(rom_file_path);
+	const auto rom_file_size = rom_image_->GetSize();
+	const auto file_header = rom_image_->GetData();
 
-	const auto rom_file_size = static_cast<size_t>(rom_read_stream.tellg());
-	rom_read_stream.seekg(0, std::ios::beg);
-
-	// Read ROM file header
-	std::array<char, 0x150> file_header;
-	if (rom_file_size < file_header.size()) throw std::invalid_argument{ "ROM file (" + std::to_string(rom_file_size) + " bytes) is smaller than header size (336 bytes)" };
-	
-	rom_read_stream.read(file_header.data(), file_header.size());
-	rom_read_stream.seekg(0, std::ios::beg);
+	// Check ROM file header
+	constexpr size_t file_header_size{ 0x150 };
+	if (rom_file_size < file_header_size) throw std::invalid_argument{ "ROM file (" + std::to_string(rom_file_size) + " bytes) is smaller than header size (336 bytes)" };
 
 	// Get number of ROM banks according to header
 	const auto num_rom_banks = GetNumRomBanks(file_header[0x148]);
 	if (rom_file_size != (num_rom_banks * Memory::rom_bank_size_)) throw std::invalid_argument{ "ROM file size (" + std::to_string(rom_file_size)
 		+ " bytes) is not the same as the ROM size according to header (" + std::to_string(num_rom_banks) + " banks of 16384 bytes)" };
 
-	// Create ROM banks
-	for (auto ii = 0; ii < num_rom_banks; ++ii)
+	// ROM banks are read straight from the image
+	for (size_t ii = 0; ii < num_rom_banks; ++ii)
 	{
-		rom_banks_.emplace_back();
-		rom_banks_.back().resize(Memory::rom_bank_size_);
-		rom_read_stream.read(reinterpret_cast<char*>(rom_banks_.back().data()), rom_banks_.back().size());
+		rom_banks_.push_back(rom_image_->GetData() + ii * Memory::rom_bank_size_);
 	}
 
-	rom_read_stream.close();
-
 	// Create the appropriate MBC
 	switch (file_header[0x147])
 	{
@@ -80,6 +72,8 @@ Cartridge::Cartridge(const std::string &rom_file_path)
 		external_ram_banks_.emplace_back(Memory::external_ram_bank_size_, uint8_t{ 0 });
 	}
 
+	UpdateDirectAccessPages();
+
 	// Verify whether the cartridge has an external battery to load RAM state file
 	const auto has_external_battery = HasExternalBattery(file_header[0x147]);
 	if (has_external_battery)
@@ -185,6 +179,24 @@ void Cartridge::UpdateSelectedBanks()
 	}
 
 	selected_external_ram_bank_ = mbc1_ram_banking_mode_enabled_ ? (((bank_selection_value_ >> 5) & GetRamBankSelectionMask())) : 0;
+
+	UpdateDirectAccessPages();
+}
+
+void Cartridge::UpdateDirectAccessPages()
+{
+	// ROM banks are read directly, while writes are still handled by the MBC
+	mmu_->MapDirectReadPages(rom_banks_[selected_rom_bank_0_], 0x0000, Memory::rom_bank_size_);
+	mmu_->MapDirectReadPages(rom_banks_[selected_rom_bank_N_], Memory::rom_bank_n_offset_, Memory::rom_bank_size_);
+
+	// External RAM can only be accessed directly while enabled
+	mmu_->UnmapDirectPages(Memory::eram_offset_, Memory::external_ram_bank_size_);
+	if (external_ram_enabled_ && !external_ram_banks_.empty())
+	{
+		auto &external_ram_bank = external_ram_banks_[selected_external_ram_bank_];
+		mmu_->MapDirectReadPages(external_ram_bank.data(), Memory::eram_offset_, external_ram_bank.size());
+		mmu_->MapDirectWritePages(external_ram_bank.data(), Memory::eram_offset_, external_ram_bank.size());
+	}
 }
 
 #pragma region MBC implementations
@@ -195,6 +207,7 @@ void Cartridge::OnMbc1Written(Memory::Address address, uint8_t value)
 	case 0x0000:
 	case 0x1000:
 		external_ram_enabled_ = ((value & 0x0F) == 0x0A);
+		UpdateDirectAccessPages();
 		break;
 	case 0x2000:
 	case 0x3000:
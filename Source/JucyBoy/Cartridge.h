@@ -3,12 +3,17 @@
 #include <cstdint>
 #include <string>
 #include <functional>
+#include <memory>
+#include <vector>
 #include "Memory.h"
+#include "RomImage.h"
+
+class MMU;
 
 class Cartridge final
 {
 public:
-	Cartridge(const std::string &rom_file_path);
+	Cartridge(MMU &mmu, const std::string &rom_file_path);
 	~Cartridge();
 
 	// MMU mapped memory read/write functions
@@ -19,6 +24,9 @@ public:
 	uint8_t OnExternalRamRead(Memory::Address address) const;
 	void OnExternalRamWritten(Memory::Address address, uint8_t value);
 
+	// Identifies the ROM, e.g. so that save states of other ROMs can be told apart
+	uint64_t GetRomHash() const { return rom_image_->GetHash(); }
+
 	template<class Archive>
 	void serialize(Archive &archive);
 
@@ -31,11 +39,13 @@ private:
 	void OnMbc1Written(Memory::Address address, uint8_t value);
 
 	void UpdateSelectedBanks();
+	void UpdateDirectAccessPages();
 	inline size_t GetRomBankSelectionMask() const { return rom_banks_.size() - 1; } // ToDo: change mask logic when supporting 72, 80 and 96 bank ROMs
 	inline size_t GetRamBankSelectionMask() const { return external_ram_banks_.empty() ? 0 : external_ram_banks_.size() - 1; }
 
 private:
-	std::vector<std::vector<uint8_t>> rom_banks_;
+	std::shared_ptr<const RomImage> rom_image_;
+	std::vector<const uint8_t*> rom_banks_; // Into the ROM image
 	std::vector<std::vector<uint8_t>> external_ram_banks_;
 
 	std::function<void(const Memory::Address&, uint8_t)> mbc_write_function_;
@@ -50,6 +60,8 @@ private:
 	bool mbc1_ram_banking_mode_enabled_{ false };
 
 	std::string eram_save_file_path_;
+
+	MMU* mmu_{ nullptr };
 };
 
 template<class Archive>
@@ -57,4 +69,7 @@ void Cartridge::serialize(Archive &archive)
 {
 	archive(external_ram_banks_);
 	archive(bank_selection_value_, selected_rom_bank_0_, selected_rom_bank_N_, selected_external_ram_bank_, external_ram_enabled_, mbc1_ram_banking_mode_enabled_);
+
+	// The external RAM banks may have been reallocated, and the selected banks may have changed
+	if (Archive::is_loading::value) UpdateDirectAccessPages();
 }
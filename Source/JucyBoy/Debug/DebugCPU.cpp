@@ -1,7 +1,7 @@
 #include "DebugCPU.h"
 #include "../MMU.h"
 
-DebugCPU::DebugCPU(MMU &mmu) : CPU{ mmu }
+DebugCPU::DebugCPU(MMU &mmu, Scheduler &scheduler) : CPU{ mmu, scheduler }
 {
 
 }
@@ -10,7 +10,7 @@ void DebugCPU::DebugRun()
 {
 	if (loop_function_result_.valid()) { return; }
 
-	exit_loop_.store(false);
+	ResetRunningLoop();
 	loop_function_result_ = std::async(std::launch::async, &DebugCPU::DebugRunningLoopFunction, this);
 }
 
@@ -33,16 +33,19 @@ void DebugCPU::DebugRunningLoopFunction()
 	{
 		//TODO: only check exit_loop_ once per frame (during VBlank), in order to increase performance
 		//TODO: precompute the next breakpoint instead of iterating the whole set every time. This "next breakpoint" would need to be updated after every Jump instruction.
-		while (!exit_loop_.load())
+		do
 		{
-			ExecuteOneInstruction();
-
-			if (IsBreakpointHit() || IsInstructionBreakpointHit() || IsWatchpointHit(mmu_->ReadByte(registers_.pc)))
+			while (!exit_loop_.load())
 			{
-				NotifyRunningLoopInterruption();
-				break;
+				ExecuteOneInstruction();
+
+				if (IsBreakpointHit() || IsInstructionBreakpointHit() || IsWatchpointHit(mmu_->ReadByte(registers_.pc)))
+				{
+					NotifyRunningLoopInterruption();
+					return;
+				}
 			}
-		}
+		} while (ContinueRunningLoop());
 	}
 	catch (std::exception &)
 	{
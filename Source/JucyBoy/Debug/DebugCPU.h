@@ -20,7 +20,7 @@ public:
 		virtual void OnWatchpointHit(Memory::Watchpoint /*watchpoint*/) {}
 	};
 
-	DebugCPU(MMU &mmu);
+	DebugCPU(MMU &mmu, Scheduler &scheduler);
 	~DebugCPU() = default;
 
 	void DebugRun();
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// 64-bit FNV-1a hash, e.g. to identify ROMs or to checksum save states. Can be computed in pieces, passing the hash of the previous ones.
+constexpr uint64_t fnv1a_hash_offset_basis{ 0xCBF29CE484222325 };
+
+inline uint64_t GetFnv1aHash(const uint8_t *data, size_t size, uint64_t hash = fnv1a_hash_offset_basis)
+{
+	for (size_t index = 0; index < size; ++index)
+	{
+		hash = (hash ^ data[index]) * 0x100000001B3;
+	}
+	return hash;
+}
@@ -1,4 +1,5 @@
 #include "InstructionMnemonics.h"
+#include <stdexcept>
 
 std::string GetInstructionMnemonic(int opcode)
 {
@@ -42,9 +42,9 @@ private:
 template<class Archive>
 void Joypad::serialize(Archive &archive)
 {
+	// The pressed keys are the input of the host rather than machine state: they are archived, but loading keeps the keys currently pressed
+	// (e.g. so that restoring the state after running ahead, or rewinding, does not undo them)
 	auto pressed_directions = pressed_directions_.load();
 	auto pressed_buttons = pressed_buttons_.load();
 	archive(pressed_directions, pressed_buttons, direction_keys_requested_, button_keys_requested_);
-	pressed_directions_.store(pressed_directions);
-	pressed_buttons_.store(pressed_buttons);
 }
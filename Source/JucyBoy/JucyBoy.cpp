@@ -1,54 +1,276 @@
 #include "JucyBoy.h"
+#include "SnapshotArchives.h"
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
 
 JucyBoy::JucyBoy(const std::string &rom_file_path) :
-	cartridge_{ rom_file_path }
+	cartridge_{ mmu_, rom_file_path }
 {
-	// Register all listener functions
-	// CPU listeners
-	cpu_.CPU::AddMachineCycleLapseListener([this]() { timer_.OnMachineCycleLapse(); });
-	cpu_.CPU::AddMachineCycleLapseListener([this]() { ppu_.OnMachineCycleLapse(); });
-	cpu_.CPU::AddMachineCycleLapseListener([this]() { apu_.OnMachineCycleLapse(); });
+	// Register all components driven by the machine cycles lapsed in the CPU
+	timer_id_ = scheduler_.AddComponent([this](size_t num_machine_cycles) { timer_.OnMachineCyclesLapsed(num_machine_cycles); }, [this]() { return timer_.GetMachineCyclesUntilNextEvent(); });
+	ppu_id_ = scheduler_.AddComponent([this](size_t num_machine_cycles) { ppu_.OnMachineCyclesLapsed(num_machine_cycles); }, [this]() { return ppu_.GetMachineCyclesUntilNextEvent(); });
+	apu_id_ = scheduler_.AddComponent([this](size_t num_machine_cycles) { apu_.OnMachineCyclesLapsed(num_machine_cycles); }, [this]() { return apu_.GetMachineCyclesUntilNextEvent(); });
+	deadline_id_ = scheduler_.AddComponent([this](size_t) { if ((scheduler_.GetCurrentCycle() >= deadline_cycle_) && (num_run_ahead_frames_left_ == 0)) cpu_.InterruptRun(); },
+		[this]() { return (deadline_cycle_ > scheduler_.GetCurrentCycle()) ? static_cast<size_t>(deadline_cycle_ - scheduler_.GetCurrentCycle()) : Scheduler::no_event_; });
+	pacing_id_ = scheduler_.AddComponent([this](size_t) { if (scheduler_.GetCurrentCycle() >= next_pacing_cycle_) PaceEmulation(); },
+		[this]() { return static_cast<size_t>(std::max(next_pacing_cycle_, scheduler_.GetCurrentCycle() + 1) - scheduler_.GetCurrentCycle()); });
 
 	// Map memory read/write functions to MMU
-	mmu_.MapMemoryRead([this](Memory::Address relative_address) { return ppu_.OnVramRead(relative_address); }, Memory::Region::VRAM);
-	mmu_.MapMemoryRead([this](Memory::Address relative_address) { return ppu_.OnOamRead(relative_address); }, Memory::Region::OAM);
+	// Components are synchronized before their memory is accessed, and rescheduled after their registers are written
+	mmu_.MapMemoryRead([this](Memory::Address relative_address) { scheduler_.Synchronize(ppu_id_); return ppu_.OnVramRead(relative_address); }, Memory::Region::VRAM);
+	mmu_.MapMemoryRead([this](Memory::Address relative_address) { scheduler_.Synchronize(ppu_id_); return ppu_.OnOamRead(relative_address); }, Memory::Region::OAM);
 	mmu_.MapMemoryRead([this](Memory::Address relative_address) { return cpu_.OnInterruptsRead(relative_address); }, Memory::Region::Interrupts);
 
-	mmu_.MapMemoryWrite([this](Memory::Address relative_address, uint8_t value) { ppu_.OnVramWritten(relative_address, value); }, Memory::Region::VRAM);
-	mmu_.MapMemoryWrite([this](Memory::Address relative_address, uint8_t value) { ppu_.OnOamWritten(relative_address, value); }, Memory::Region::OAM);
+	mmu_.MapMemoryWrite([this](Memory::Address relative_address, uint8_t value) { scheduler_.Synchronize(ppu_id_); ppu_.OnVramWritten(relative_address, value); }, Memory::Region::VRAM);
+	mmu_.MapMemoryWrite([this](Memory::Address relative_address, uint8_t value) { scheduler_.Synchronize(ppu_id_); ppu_.OnOamWritten(relative_address, value); }, Memory::Region::OAM);
 	mmu_.MapMemoryWrite([this](Memory::Address relative_address, uint8_t value) { cpu_.OnInterruptsWritten(relative_address, value); }, Memory::Region::Interrupts);
 
 	// Map IO register read/write functions to MMU
 	mmu_.MapIoRegisterRead([this](Memory::Address relative_address) { return cpu_.OnIoMemoryRead(relative_address); }, Memory::IF, Memory::IF);
-	mmu_.MapIoRegisterRead([this](Memory::Address relative_address) { return ppu_.OnIoMemoryRead(relative_address); }, Memory::LCDC, Memory::WX);
-	mmu_.MapIoRegisterRead([this](Memory::Address relative_address) { return apu_.OnIoMemoryRead(relative_address); }, Memory::NR10, Memory::WaveEnd);
-	mmu_.MapIoRegisterRead([this](Memory::Address relative_address) { return timer_.OnIoMemoryRead(relative_address); }, Memory::DIV, Memory::TAC);
+	mmu_.MapIoRegisterRead([this](Memory::Address relative_address) { scheduler_.Synchronize(ppu_id_); return ppu_.OnIoMemoryRead(relative_address); }, Memory::LCDC, Memory::WX);
+	mmu_.MapIoRegisterRead([this](Memory::Address relative_address) { scheduler_.Synchronize(apu_id_); return apu_.OnIoMemoryRead(relative_address); }, Memory::NR10, Memory::WaveEnd);
+	mmu_.MapIoRegisterRead([this](Memory::Address relative_address) { scheduler_.Synchronize(timer_id_); return timer_.OnIoMemoryRead(relative_address); }, Memory::DIV, Memory::TAC);
 	mmu_.MapIoRegisterRead([this](Memory::Address relative_address) { return joypad_.OnIoMemoryRead(relative_address); }, Memory::JOYP, Memory::JOYP);
 	mmu_.MapMemoryRead([this](Memory::Address relative_address) { return cartridge_.OnRomBank0Read(relative_address); }, Memory::Region::ROM_Bank0);
 	mmu_.MapMemoryRead([this](Memory::Address relative_address) { return cartridge_.OnRomBankNRead(relative_address); }, Memory::Region::ROM_OtherBanks);
 	mmu_.MapMemoryRead([this](Memory::Address relative_address) { return cartridge_.OnExternalRamRead(relative_address); }, Memory::Region::ERAM);
 
 	mmu_.MapIoRegisterWrite([this](Memory::Address relative_address, uint8_t value) { cpu_.OnIoMemoryWritten(relative_address, value); }, Memory::IF, Memory::IF);
-	mmu_.MapIoRegisterWrite([this](Memory::Address relative_address, uint8_t value) { ppu_.OnIoMemoryWritten(relative_address, value); }, Memory::LCDC, Memory::WX);
-	mmu_.MapIoRegisterWrite([this](Memory::Address relative_address, uint8_t value) { apu_.OnIoMemoryWritten(relative_address, value); }, Memory::NR10, Memory::WaveEnd);
-	mmu_.MapIoRegisterWrite([this](Memory::Address relative_address, uint8_t value) { timer_.OnIoMemoryWritten(relative_address, value); }, Memory::DIV, Memory::TAC);
+	mmu_.MapIoRegisterWrite([this](Memory::Address relative_address, uint8_t value) { scheduler_.Synchronize(ppu_id_); ppu_.OnIoMemoryWritten(relative_address, value); scheduler_.Reschedule(ppu_id_); }, Memory::LCDC, Memory::WX);
+	mmu_.MapIoRegisterWrite([this](Memory::Address relative_address, uint8_t value) { scheduler_.Synchronize(apu_id_); apu_.OnIoMemoryWritten(relative_address, value); scheduler_.Reschedule(apu_id_); }, Memory::NR10, Memory::WaveEnd);
+	mmu_.MapIoRegisterWrite([this](Memory::Address relative_address, uint8_t value) { scheduler_.Synchronize(timer_id_); timer_.OnIoMemoryWritten(relative_address, value); scheduler_.Reschedule(timer_id_); }, Memory::DIV, Memory::TAC);
 	mmu_.MapIoRegisterWrite([this](Memory::Address relative_address, uint8_t value) { joypad_.OnIoMemoryWritten(relative_address, value); }, Memory::JOYP, Memory::JOYP);
 	mmu_.MapMemoryWrite([this](Memory::Address relative_address, uint8_t value) { cartridge_.OnRomBank0Written(relative_address, value); }, Memory::Region::ROM_Bank0);
 	mmu_.MapMemoryWrite([this](Memory::Address relative_address, uint8_t value) { cartridge_.OnRomBankNWritten(relative_address, value); }, Memory::Region::ROM_OtherBanks);
 	mmu_.MapMemoryWrite([this](Memory::Address relative_address, uint8_t value) { cartridge_.OnExternalRamWritten(relative_address, value); }, Memory::Region::ERAM);
+
+	// Frames are completed while the PPU is being synchronized, so the frame safe point listeners are called by the CPU right after the current instruction
+	ppu_.AddNewFrameListener([this]()
+	{
+		if (!frame_safe_point_listeners_.empty() || !frame_presentation_listeners_.empty() || (num_run_ahead_frames_left_ != 0) || (num_run_ahead_frames_.load() != 0)) cpu_.RequestSafePoint();
+	});
+	cpu_.SetSafePointFunction([this]() { OnFrameSafePoint(); });
 }
 
 void JucyBoy::StartEmulation(bool debug)
 {
+	// Time does not run for the emulation while it is paused
+	ResetPacing();
+
+	// Breakpoints must stop at the frames that are actually emulated
+	is_run_ahead_allowed_ = !debug;
+
 	debug ? cpu_.DebugRun() : cpu_.Run();
 }
 
 void JucyBoy::PauseEmulation()
 {
 	cpu_.Stop();
+	if (num_run_ahead_frames_left_ != 0) FinishRunAhead();
+
+	// Let the rest of the components catch up with the CPU, so that their state can be inspected
+	scheduler_.Synchronize();
+	apu_.FlushSamples();
+}
+
+void JucyBoy::RunMachineCycles(uint64_t num_machine_cycles)
+{
+	if (num_machine_cycles == 0) { return; }
+
+	deadline_cycle_ = scheduler_.GetCurrentCycle() + num_machine_cycles;
+	scheduler_.Synchronize(deadline_id_);
+
+	is_run_ahead_allowed_ = true;
+	cpu_.RunInCallingThread();
+	if (num_run_ahead_frames_left_ != 0) FinishRunAhead();
+
+	deadline_cycle_ = no_deadline_;
+	scheduler_.Synchronize();
+	apu_.FlushSamples();
 }
 
 void JucyBoy::StepOver(bool debug)
 {
 	debug ? cpu_.DebugStepOver() : cpu_.StepOver();
+
+	scheduler_.Synchronize();
+}
+
+std::function<void()> JucyBoy::AddFrameSafePointListener(SafePointListener &&listener)
+{
+	auto it = frame_safe_point_listeners_.emplace(frame_safe_point_listeners_.begin(), std::move(listener));
+	return [it, this]() { frame_safe_point_listeners_.erase(it); };
+}
+
+std::function<void()> JucyBoy::AddFramePresentationListener(FramePresentationListener &&listener)
+{
+	auto it = frame_presentation_listeners_.emplace(frame_presentation_listeners_.begin(), std::move(listener));
+	return [it, this]() { frame_presentation_listeners_.erase(it); };
+}
+
+void JucyBoy::OnFrameSafePoint()
+{
+	// Frames emulated ahead are only seen by the frame presentation listeners, and only the last one of them
+	if (num_run_ahead_frames_left_ != 0)
+	{
+		if (num_run_ahead_frames_left_ > 1)
+		{
+			--num_run_ahead_frames_left_;
+			return;
+		}
+
+		NotifyFramePresentation();
+		FinishRunAhead();
+		return;
+	}
+
+	for (auto &listener : frame_safe_point_listeners_)
+	{
+		listener();
+	}
+
+	const auto num_run_ahead_frames = is_run_ahead_allowed_ ? num_run_ahead_frames_.load() : 0;
+	if (num_run_ahead_frames != 0)
+	{
+		StartRunAhead(num_run_ahead_frames);
+		return;
+	}
+
+	NotifyFramePresentation();
+}
+
+void JucyBoy::NotifyFramePresentation()
+{
+	for (auto &listener : frame_presentation_listeners_)
+	{
+		listener();
+	}
+}
+
+void JucyBoy::StartRunAhead(size_t num_frames)
+{
+	SaveSnapshot(run_ahead_snapshot_);
+	apu_.SetMuted(true);
+	num_run_ahead_frames_left_ = num_frames;
+	run_ahead_start_cycle_ = scheduler_.GetCurrentCycle();
+}
+
+void JucyBoy::FinishRunAhead()
+{
+	const auto num_run_ahead_cycles = scheduler_.GetCurrentCycle() - run_ahead_start_cycle_;
+
+	// Still running ahead while loading, since it synchronizes the deadline
+	LoadSnapshot(run_ahead_snapshot_);
+	apu_.SetMuted(false);
+
+	// The scheduler cycles keep counting, so the cycles spent running ahead are skipped by everything timed by them
+	pacing_start_cycle_ += num_run_ahead_cycles;
+	speed_measurement_start_cycle_ += num_run_ahead_cycles;
+	if (deadline_cycle_ != no_deadline_) deadline_cycle_ += num_run_ahead_cycles;
+
+	num_run_ahead_frames_left_ = 0;
+	scheduler_.Reschedule(deadline_id_);
+}
+
+void JucyBoy::Snapshot::Assign(const uint8_t *data, size_t size)
+{
+	if (data_.size() < size) data_.resize(size);
+	std::copy(data, data + size, data_.begin());
+	size_ = size;
+	section_ends_.fill(size);
+}
+
+JucyBoy::Snapshot JucyBoy::CreateSnapshot()
+{
+	Snapshot snapshot;
+	SaveSnapshot(snapshot);
+
+	// Leave some room for the state to grow (the blip buffers grow with the output sample rate)
+	snapshot.data_.resize(snapshot.size_ + snapshot.size_ / snapshot_headroom_divisor_);
+	return snapshot;
+}
+
+void JucyBoy::SaveSnapshot(Snapshot &snapshot)
+{
+	// Laid out as serialize does, but keeping track of the sections
+	SnapshotOutputArchive output_archive{ snapshot.data_ };
+	scheduler_.Synchronize();
+	ArchiveSections(output_archive, [&snapshot, &output_archive](size_t section_index) { snapshot.section_ends_[section_index] = output_archive.GetSize(); });
+	scheduler_.Synchronize();
+	snapshot.size_ = output_archive.GetSize();
+}
+
+void JucyBoy::LoadSnapshot(const Snapshot &snapshot)
+{
+	SnapshotInputArchive input_archive{ snapshot.data_.data(), snapshot.size_ };
+	input_archive(*this);
+}
+
+void JucyBoy::SetEmulationSpeed(double speed)
+{
+	if (speed < 0.0) { throw std::invalid_argument{ "Invalid emulation speed: " + std::to_string(speed) }; }
+
+	// Picked up by the running loop on its next pacing event
+	emulation_speed_.store(speed);
+}
+
+void JucyBoy::ResetPacing()
+{
+	pacing_speed_ = emulation_speed_.load();
+	pacing_start_cycle_ = scheduler_.GetCurrentCycle();
+	pacing_start_time_ = Clock::now();
+	next_pacing_cycle_ = pacing_start_cycle_ + pacing_period_;
+	speed_measurement_start_cycle_ = pacing_start_cycle_;
+	speed_measurement_start_time_ = pacing_start_time_;
+	scheduler_.Reschedule(pacing_id_);
+}
+
+void JucyBoy::PaceEmulation()
+{
+	const auto current_cycle = scheduler_.GetCurrentCycle();
+
+	// Running ahead does not take emulated time (see FinishRunAhead)
+	if (num_run_ahead_frames_left_ != 0)
+	{
+		next_pacing_cycle_ = current_cycle + pacing_period_;
+		return;
+	}
+	const auto now = Clock::now();
+
+	if (now - speed_measurement_start_time_ >= speed_measurement_period_)
+	{
+		const std::chrono::duration<double> emulated_time = MachineCycles{ static_cast<int64_t>(current_cycle - speed_measurement_start_cycle_) };
+		measured_speed_.store(emulated_time / (now - speed_measurement_start_time_));
+		speed_measurement_start_cycle_ = current_cycle;
+		speed_measurement_start_time_ = now;
+	}
+
+	// The speed may have been changed from another thread: start pacing again from here
+	const auto speed = emulation_speed_.load();
+	if (speed != pacing_speed_)
+	{
+		pacing_speed_ = speed;
+		pacing_start_cycle_ = current_cycle;
+		pacing_start_time_ = now;
+	}
+
+	if (speed != uncapped_speed_)
+	{
+		const std::chrono::duration<double> emulated_time = MachineCycles{ static_cast<int64_t>(current_cycle - pacing_start_cycle_) };
+		const auto target_time = pacing_start_time_ + std::chrono::duration_cast<Clock::duration>(emulated_time / speed);
+
+		if (now < target_time)
+		{
+			std::this_thread::sleep_until(target_time);
+		}
+		else if (now - target_time > max_pacing_lag_)
+		{
+			// Too far behind (e.g. the host was busy): do not try to catch up, since that would run the emulation too fast for a while
+			pacing_start_cycle_ = current_cycle;
+			pacing_start_time_ = now;
+		}
+	}
+
+	next_pacing_cycle_ = current_cycle + pacing_period_;
 }
@@ -1,8 +1,16 @@
 #pragma once
 
 #include <string>
+#include <atomic>
+#include <limits>
+#include <chrono>
+#include <vector>
+#include <list>
+#include <functional>
+#include <array>
 #include "Debug/DebugCPU.h"
 #include "MMU.h"
+#include "Scheduler.h"
 #include "PPU.h"
 #include "APU.h"
 #include "Timer.h"
@@ -21,25 +29,159 @@ public:
 
 	void StepOver(bool debug);
 
+	// Runs in the calling thread, as fast as possible, until the given number of machine cycles have lapsed
+	void RunMachineCycles(uint64_t num_machine_cycles);
+
+	// Emulation speed, relative to the real hardware: when capped, the emulation sleeps a few times per frame as needed to run at that speed.
+	// When uncapped (the default), it runs as fast as possible (or as fast as the listeners let it). Can be changed while running.
+	static constexpr double uncapped_speed_{ 0.0 };
+	void SetEmulationSpeed(double speed);
+	double GetEmulationSpeed() const { return emulation_speed_.load(); }
+
+	// Speed actually achieved while running, measured periodically (e.g. to know how fast an uncapped emulation runs)
+	double GetMeasuredSpeed() const { return measured_speed_.load(); }
+
+	// Full machine state in a flat buffer, for frequent in-memory captures (e.g. rewind or run-ahead), laid out as in a binary save state.
+	// Its buffer is allocated by CreateSnapshot and reused by every capture, so that neither capturing nor restoring allocate memory
+	// (unless the state outgrows it, e.g. when the APU output sample rate is raised).
+	// A snapshot is made of a section per component (CPU, MMU, PPU, APU, Timer, Joypad and Cartridge, in this order), one after the other.
+	static constexpr size_t num_snapshot_sections_{ 7 };
+	class Snapshot final
+	{
+	public:
+		const uint8_t* GetData() const { return data_.data(); }
+		size_t GetSize() const { return size_; }
+		size_t GetSectionEnd(size_t section_index) const { return section_ends_[section_index]; }
+
+		// Copies a snapshot kept elsewhere (e.g. in a rewind buffer), reusing the buffer whenever it is large enough.
+		// Its sections are not known, so it is taken as a single one.
+		void Assign(const uint8_t *data, size_t size);
+
+	private:
+		friend class JucyBoy;
+		std::vector<uint8_t> data_;
+		size_t size_{ 0 };
+		std::array<size_t, num_snapshot_sections_> section_ends_{};
+	};
+
+	// Called from the emulation thread once per frame, right after the frame is completed (and its new frame listeners called), at a CPU safe point:
+	// the whole machine state can be saved or replaced from these listeners (e.g. with SaveSnapshot or LoadSnapshot), and the emulation carries on from there
+	using SafePointListener = std::function<void()>;
+	std::function<void()> AddFrameSafePointListener(SafePointListener &&listener);
+
+	// Called from the emulation thread once per frame to be presented (the frame just completed, or the last one emulated ahead with run-ahead), at a CPU safe point
+	using FramePresentationListener = std::function<void()>;
+	std::function<void()> AddFramePresentationListener(FramePresentationListener &&listener);
+
+	// Run-ahead: after each frame, the given number of frames are emulated ahead with the keys currently pressed (muted, and without calling the frame safe point listeners),
+	// the last of them is presented, and then the state of the frame they started from is restored. This hides as many frames of input lag as the game has.
+	// The frames emulated ahead do not count as emulated time (for pacing, nor for RunMachineCycles). Can be changed while running, and is disabled when debugging.
+	void SetRunAheadFrames(size_t num_frames) { num_run_ahead_frames_.store(num_frames); }
+	size_t GetRunAheadFrames() const { return num_run_ahead_frames_.load(); }
+
+	// Like serialize, these must only be called while the emulation is not running, or from a safe point listener
+	Snapshot CreateSnapshot();
+	void SaveSnapshot(Snapshot &snapshot);
+	void LoadSnapshot(const Snapshot &snapshot);
+
+	// To be increased whenever what is archived changes, so that the save state files of other versions are rejected rather than misread
+	static constexpr uint32_t state_version_{ 1 };
+
 	template<class Archive>
 	void serialize(Archive &archive)
 	{
-		archive(cpu_, mmu_, ppu_, apu_, timer_, joypad_, cartridge_);
+		// Components must not have pending machine cycles neither before nor after being (de)serialized
+		scheduler_.Synchronize();
+		ArchiveSections(archive, [](size_t) {});
+		scheduler_.Synchronize();
 	}
 
+	uint64_t GetRomHash() const { return cartridge_.GetRomHash(); }
+
 public:
 	DebugCPU& GetCpu() { return cpu_; }
 	MMU& GetMmu() { return mmu_; }
+	Scheduler& GetScheduler() { return scheduler_; }
 	PPU& GetPpu() { return ppu_; }
 	APU& GetApu() { return apu_; }
 	Joypad& GetJoypad() { return joypad_; }
 
+	// Scheduler component ids, for profiling (see Scheduler::GetSynchronizationTime)
+	Scheduler::ComponentId GetTimerId() const { return timer_id_; }
+	Scheduler::ComponentId GetPpuId() const { return ppu_id_; }
+	Scheduler::ComponentId GetApuId() const { return apu_id_; }
+
 private:
 	MMU mmu_;
-	DebugCPU cpu_{ mmu_ };
+	Scheduler scheduler_;
+	DebugCPU cpu_{ mmu_, scheduler_ };
 	PPU ppu_{ mmu_ };
 	APU apu_;
 	Timer timer_{ mmu_ };
 	Joypad joypad_;
 	Cartridge cartridge_;
+
+	Scheduler::ComponentId timer_id_{ 0 };
+	Scheduler::ComponentId ppu_id_{ 0 };
+	Scheduler::ComponentId apu_id_{ 0 };
+
+	// RunMachineCycles deadline, handled as a scheduler event so that the running loop is interrupted on time
+	static constexpr uint64_t no_deadline_{ std::numeric_limits<uint64_t>::max() };
+	uint64_t deadline_cycle_{ no_deadline_ };
+	Scheduler::ComponentId deadline_id_{ 0 };
+
+	static constexpr size_t snapshot_headroom_divisor_{ 16 };
+
+	template<class Archive, class SectionListener>
+	void ArchiveSections(Archive &archive, SectionListener &&on_section_archived)
+	{
+		archive(cpu_);
+		on_section_archived(0);
+		archive(mmu_);
+		on_section_archived(1);
+		archive(ppu_);
+		on_section_archived(2);
+		archive(apu_);
+		on_section_archived(3);
+		archive(timer_);
+		on_section_archived(4);
+		archive(joypad_);
+		on_section_archived(5);
+		archive(cartridge_);
+		on_section_archived(6);
+	}
+
+	std::list<SafePointListener> frame_safe_point_listeners_;
+	std::list<FramePresentationListener> frame_presentation_listeners_;
+	void OnFrameSafePoint();
+	void NotifyFramePresentation();
+
+	// Run-ahead
+	void StartRunAhead(size_t num_frames);
+	void FinishRunAhead();
+
+	std::atomic<size_t> num_run_ahead_frames_{ 0 };
+	bool is_run_ahead_allowed_{ true };
+	size_t num_run_ahead_frames_left_{ 0 };	// Non-zero while running ahead
+	uint64_t run_ahead_start_cycle_{ 0 };
+	Snapshot run_ahead_snapshot_;
+
+	// Pacing (and speed measurement), handled as a scheduler event a few times per frame
+	void ResetPacing();
+	void PaceEmulation();
+
+	using Clock = std::chrono::steady_clock;
+	using MachineCycles = std::chrono::duration<int64_t, std::ratio<4, 4194304>>; // One machine cycle is 4 clock cycles, at 4.194304 MHz
+	static constexpr uint64_t pacing_period_{ PPU::frame_duration_ / 4 };
+	static constexpr Clock::duration max_pacing_lag_{ std::chrono::milliseconds{ 100 } };
+	static constexpr Clock::duration speed_measurement_period_{ std::chrono::milliseconds{ 100 } };
+	std::atomic<double> emulation_speed_{ uncapped_speed_ };
+	double pacing_speed_{ uncapped_speed_ };	// Speed the pacing start point was taken with
+	uint64_t pacing_start_cycle_{ 0 };
+	Clock::time_point pacing_start_time_;
+	uint64_t next_pacing_cycle_{ 0 };
+	Scheduler::ComponentId pacing_id_{ 0 };
+	std::atomic<double> measured_speed_{ 1.0 };
+	uint64_t speed_measurement_start_cycle_{ 0 };
+	Clock::time_point speed_measurement_start_time_;
 };
@@ -0,0 +1,126 @@
+#include "LzCodec.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+	void PutVarint(std::vector<uint8_t> &bytes, size_t value)
+	{
+		while (value >= 0x80)
+		{
+			bytes.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		bytes.push_back(static_cast<uint8_t>(value));
+	}
+
+	size_t GetVarint(const uint8_t *&position, const uint8_t *end)
+	{
+		size_t value{ 0 };
+		for (size_t shift = 0; position != end; shift += 7)
+		{
+			const auto byte = *position++;
+			value |= static_cast<size_t>(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0) return value;
+		}
+		throw std::runtime_error{ "Truncated LZ encoded data" };
+	}
+}
+
+void LzCodec::Encode(const uint8_t *data, size_t size, std::vector<uint8_t> &encoded_data)
+{
+	const auto load_word = [data](size_t index)
+	{
+		uint32_t word;
+		std::memcpy(&word, data + index, sizeof(word));
+		return word;
+	};
+
+	std::fill(match_table_.begin(), match_table_.end(), 0);
+
+	size_t literal_start{ 0 };
+	size_t index{ 0 };
+	while (index + min_match_length_ <= size)
+	{
+		// Runs of the same byte match the byte before them, other matches are looked up by their first bytes
+		size_t match_offset{ 0 };
+		const auto word = load_word(index);
+		if ((index > 0) && (word == data[index - 1] * 0x01010101u))
+		{
+			match_offset = 1;
+		}
+		else
+		{
+			auto &match_table_entry = match_table_[(word * 2654435761u) >> (32 - match_table_bits_)];
+			const auto candidate = match_table_entry;
+			match_table_entry = index;
+			if ((candidate < index) && (load_word(candidate) == word)) match_offset = index - candidate;
+		}
+
+		if (match_offset == 0)
+		{
+			++index;
+			continue;
+		}
+
+		auto match_length = min_match_length_;
+		while ((index + match_length + sizeof(uint32_t) <= size) && (load_word(index + match_length) == load_word(index + match_length - match_offset))) match_length += sizeof(uint32_t);
+		while ((index + match_length < size) && (data[index + match_length] == data[index + match_length - match_offset])) ++match_length;
+
+		PutVarint(encoded_data, index - literal_start);
+		encoded_data.insert(encoded_data.end(), data + literal_start, data + index);
+		PutVarint(encoded_data, match_length);
+		PutVarint(encoded_data, match_offset);
+
+		index += match_length;
+		literal_start = index;
+	}
+
+	if (literal_start < size)
+	{
+		PutVarint(encoded_data, size - literal_start);
+		encoded_data.insert(encoded_data.end(), data + literal_start, data + size);
+		PutVarint(encoded_data, 0);
+	}
+}
+
+void LzCodec::Decode(const uint8_t *encoded_data, size_t encoded_size, uint8_t *data, size_t size)
+{
+	const auto *position = encoded_data;
+	const auto *end = position + encoded_size;
+
+	size_t index{ 0 };
+	while (position != end)
+	{
+		const auto literal_length = GetVarint(position, end);
+		if ((literal_length > size - index) || (literal_length > static_cast<size_t>(end - position))) { throw std::runtime_error{ "Corrupted LZ encoded data, at byte: " + std::to_string(index) }; }
+		std::memcpy(data + index, position, literal_length);
+		index += literal_length;
+		position += literal_length;
+
+		const auto match_length = GetVarint(position, end);
+		if (match_length == 0) continue;
+
+		const auto match_offset = GetVarint(position, end);
+		if ((match_offset == 0) || (match_offset > index) || (match_length > size - index)) { throw std::runtime_error{ "Corrupted LZ encoded data, at byte: " + std::to_string(index) }; }
+
+		// Matches may overlap themselves (e.g. runs of the same byte)
+		if (match_offset == 1)
+		{
+			std::memset(data + index, data[index - 1], match_length);
+			index += match_length;
+		}
+		else if (match_offset >= match_length)
+		{
+			std::memcpy(data + index, data + index - match_offset, match_length);
+			index += match_length;
+		}
+		else
+		{
+			for (const auto match_end = index + match_length; index < match_end; ++index) data[index] = data[index - match_offset];
+		}
+	}
+	if (index != size) { throw std::runtime_error{ "Truncated LZ encoded data, at byte: " + std::to_string(index) }; }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Fast LZ77 codec for machine state (e.g. snapshots, or their deltas): sequences of literal bytes followed by a match (a copy of earlier bytes),
+// where runs of the same byte (above all, zeros) are matches with the byte before them.
+// Each sequence is the literal length, the literal bytes, the match length (0 if there is no match) and the match offset, as variable length integers.
+class LzCodec final
+{
+public:
+	LzCodec() = default;
+	~LzCodec() = default;
+
+	// Appends the encoded data, so that it can follow other data (e.g. a header)
+	void Encode(const uint8_t *data, size_t size, std::vector<uint8_t> &encoded_data);
+
+	// Throws if the encoded data is corrupted, or does not decode to exactly the given size
+	static void Decode(const uint8_t *encoded_data, size_t encoded_size, uint8_t *data, size_t size);
+
+private:
+	// Shorter matches would take about as many bytes to encode as they save
+	static constexpr size_t min_match_length_{ 4 };
+	static constexpr size_t match_table_bits_{ 14 };
+
+	std::array<size_t, 1 << match_table_bits_> match_table_;	// Latest position of each hash of the first bytes of a match
+};
@@ -1,4 +1,6 @@
 #include "MMU.h"
+#include <string>
+#include <stdexcept>
 
 MMU::MMU()
 {
@@ -26,6 +28,12 @@ MMU::MMU()
 	wram_.fill(0);
 	hram_.fill(0);
 	unmapped_io_registers_.fill(0xFF);
+
+	// WRAM (and its echo) can always be accessed directly
+	MapDirectReadPages(wram_.data(), Memory::wram_offset_, wram_.size());
+	MapDirectWritePages(wram_.data(), Memory::wram_offset_, wram_.size());
+	MapDirectReadPages(wram_.data(), Memory::wram_echo_offset_, Memory::wram_echo_size_);
+	MapDirectWritePages(wram_.data(), Memory::wram_echo_offset_, Memory::wram_echo_size_);
 }
 
 #pragma region Memory read/write function mapping
@@ -56,6 +64,138 @@ void MMU::MapIoRegisterWrite(MemoryWriteFunction &&io_register_write_function, M
 }
 #pragma endregion
 
+#pragma region Direct access pages
+void MMU::MapDirectReadPages(const uint8_t *memory, Memory::Address first_address, size_t size)
+{
+	if (((first_address % page_size_) != 0) || ((size % page_size_) != 0) || ((first_address + size) > (page_size_ * read_pages_.size())))
+	{
+		throw std::invalid_argument{ "Invalid direct access pages: address " + std::to_string(first_address) + ", size " + std::to_string(size) };
+	}
+
+	for (size_t offset = 0; offset < size; offset += page_size_)
+	{
+		read_pages_[(first_address + offset) / page_size_] = memory + offset;
+	}
+	++mapping_generation_;
+}
+
+void MMU::MapDirectWritePages(uint8_t *memory, Memory::Address first_address, size_t size)
+{
+	if (((first_address % page_size_) != 0) || ((size % page_size_) != 0) || ((first_address + size) > (page_size_ * write_pages_.size())))
+	{
+		throw std::invalid_argument{ "Invalid direct access pages: address " + std::to_string(first_address) + ", size " + std::to_string(size) };
+	}
+
+	for (size_t offset = 0; offset < size; offset += page_size_)
+	{
+		write_pages_[(first_address + offset) / page_size_] = memory + offset;
+	}
+	++mapping_generation_;
+}
+
+void MMU::UnmapDirectPages(Memory::Address first_address, size_t size)
+{
+	if (((first_address % page_size_) != 0) || ((size % page_size_) != 0) || ((first_address + size) > (page_size_ * read_pages_.size())))
+	{
+		throw std::invalid_argument{ "Invalid direct access pages: address " + std::to_string(first_address) + ", size " + std::to_string(size) };
+	}
+
+	for (size_t offset = 0; offset < size; offset += page_size_)
+	{
+		read_pages_[(first_address + offset) / page_size_] = nullptr;
+		write_pages_[(first_address + offset) / page_size_] = nullptr;
+	}
+	++mapping_generation_;
+}
+#pragma endregion
+
+#pragma region Code pages
+const uint8_t* MMU::GetCodePointer(Memory::Address address) const
+{
+	if ((address < Memory::vram_offset_) || ((address >= Memory::wram_offset_) && (address < Memory::wram_echo_offset_)))
+	{
+		const auto page = read_pages_[address >> 8];
+		return (page != nullptr) ? (page + (address & 0xFF)) : nullptr;
+	}
+	if ((address >= Memory::hram_offset_) && (address < Memory::interrupts_offset_))
+	{
+		return &hram_[address - Memory::hram_offset_];
+	}
+	return nullptr;
+}
+
+void MMU::WatchCodePage(Memory::Address address)
+{
+	const auto page = address >> 8;
+	if (code_pages_[page]) { return; }
+
+	if ((address >= Memory::wram_offset_) && (address < Memory::wram_echo_offset_))
+	{
+		// Both the WRAM page and its echo stop being directly writable
+		const auto wram_page_address = static_cast<Memory::Address>(address & ~(page_size_ - 1));
+		write_pages_[page] = nullptr;
+		code_pages_[page] = true;
+		if ((wram_page_address + Memory::wram_size_) < Memory::oam_offset_)
+		{
+			write_pages_[page + (Memory::wram_size_ / page_size_)] = nullptr;
+			code_pages_[page + (Memory::wram_size_ / page_size_)] = true;
+		}
+	}
+	else if ((address >= Memory::hram_offset_) && (address < Memory::interrupts_offset_))
+	{
+		// HRAM is never directly accessed, so it is always written through OnCodePageWritten
+		code_pages_[page] = true;
+	}
+	else
+	{
+		throw std::invalid_argument{ "Trying to watch a code page outside WRAM/HRAM: address " + std::to_string(address) };
+	}
+}
+
+void MMU::OnCodePageWritten(Memory::Address address)
+{
+	Memory::Address code_address{ address };
+
+	if ((address >= Memory::wram_offset_) && (address < Memory::oam_offset_))
+	{
+		// Writes to the echo invalidate the code in the WRAM page they alias
+		if (address >= Memory::wram_echo_offset_) { code_address -= static_cast<Memory::Address>(Memory::wram_size_); }
+
+		const auto wram_page_address = static_cast<Memory::Address>(code_address & ~(page_size_ - 1));
+		code_pages_[wram_page_address >> 8] = false;
+		MapDirectWritePages(&wram_[wram_page_address - Memory::wram_offset_], wram_page_address, page_size_);
+		if ((wram_page_address + Memory::wram_size_) < Memory::oam_offset_)
+		{
+			code_pages_[(wram_page_address + Memory::wram_size_) >> 8] = false;
+			MapDirectWritePages(&wram_[wram_page_address - Memory::wram_offset_], static_cast<Memory::Address>(wram_page_address + Memory::wram_size_), page_size_);
+		}
+	}
+	else if ((address >= Memory::hram_offset_) && (address < Memory::interrupts_offset_))
+	{
+		code_pages_[address >> 8] = false;
+		++mapping_generation_;
+	}
+	else
+	{
+		// Writes to IO registers or IE, which share the page with HRAM
+		return;
+	}
+
+	for (auto &listener : code_page_write_listeners_)
+	{
+		listener(code_address);
+	}
+}
+#pragma endregion
+
+#pragma region Listeners management
+std::function<void()> MMU::AddCodePageWriteListener(CodePageWriteListener &&listener)
+{
+	auto it = code_page_write_listeners_.emplace(code_page_write_listeners_.begin(), listener);
+	return [it, this]() { code_page_write_listeners_.erase(it); };
+}
+#pragma endregion
+
 #pragma region Debug
 Memory::Map MMU::GetMemoryMap() const
 {
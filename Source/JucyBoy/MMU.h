@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <array>
 #include <functional>
+#include <list>
 #include "Memory.h"
 
 class MMU
@@ -11,8 +12,21 @@ public:
 	MMU();
 	virtual ~MMU() = default;
 
-	inline uint8_t ReadByte(Memory::Address address) const { return mapped_memory_reads_[static_cast<size_t>(Memory::GetRegion(address))](address); }
-	void WriteByte(Memory::Address address, uint8_t value) { mapped_memory_writes_[static_cast<size_t>(Memory::GetRegion(address))](address, value); }
+	inline uint8_t ReadByte(Memory::Address address) const
+	{
+		const auto page = read_pages_[address >> 8];
+		if (page != nullptr) return page[address & 0xFF];
+		if ((address >= Memory::hram_offset_) && (address < Memory::interrupts_offset_)) return OnHramRead(address);
+		return mapped_memory_reads_[static_cast<size_t>(Memory::GetRegion(address))](address);
+	}
+	inline void WriteByte(Memory::Address address, uint8_t value)
+	{
+		const auto page = write_pages_[address >> 8];
+		if (page != nullptr) { page[address & 0xFF] = value; return; }
+		if (code_pages_[address >> 8]) { OnCodePageWritten(address); }
+		if ((address >= Memory::hram_offset_) && (address < Memory::interrupts_offset_)) { OnHramWritten(address, value); return; }
+		mapped_memory_writes_[static_cast<size_t>(Memory::GetRegion(address))](address, value);
+	}
 
 	inline void SetBit(Memory::Address address, int bit_num) { WriteByte(address, (1 << bit_num) | ReadByte(address)); }
 	inline void ClearBit(Memory::Address address, int bit_num) { WriteByte(address, ~(1 << bit_num) & ReadByte(address)); }
@@ -25,6 +39,26 @@ public:
 	void MapIoRegisterRead(MemoryReadFunction &&io_register_read_function, Memory::Address first_register, Memory::Address last_register);
 	void MapIoRegisterWrite(MemoryWriteFunction &&io_register_write_function, Memory::Address first_register, Memory::Address last_register);
 
+	// Direct access pages: host memory read/written without calling the mapped functions above, in pages of 256 bytes.
+	// The mapped memory must stay valid until the pages are unmapped (or remapped).
+	static constexpr size_t page_size_{ 0x100 };
+	void MapDirectReadPages(const uint8_t *memory, Memory::Address first_address, size_t size);
+	void MapDirectWritePages(uint8_t *memory, Memory::Address first_address, size_t size);
+	void UnmapDirectPages(Memory::Address first_address, size_t size);
+
+	// Incremented whenever the direct access pages are remapped, or a watched code page is written.
+	// While it stays the same, the code returned by GetCodePointer is guaranteed not to have changed.
+	inline uint64_t GetMappingGeneration() const { return mapping_generation_; }
+
+	// Code fetching: host memory backing the given address if it is ROM, WRAM or HRAM (nullptr otherwise).
+	// WRAM and HRAM pages must be watched before caching any code read from them, in order to be notified when it is overwritten.
+	const uint8_t* GetCodePointer(Memory::Address address) const;
+	void WatchCodePage(Memory::Address address);
+
+	// Listeners management
+	using CodePageWriteListener = std::function<void(Memory::Address address)>;
+	std::function<void()> AddCodePageWriteListener(CodePageWriteListener &&listener);
+
 	// Debug / GUI interaction
 	Memory::Map GetMemoryMap() const;
 
@@ -50,12 +84,22 @@ private:
 	uint8_t OnHramRead(Memory::Address address) const { return hram_[address - Memory::hram_offset_]; }
 	void OnHramWritten(Memory::Address address, uint8_t value) { hram_[address - Memory::hram_offset_] = value; }
 
+	void OnCodePageWritten(Memory::Address address);
+
 private:
 	std::array<MemoryReadFunction, static_cast<size_t>(Memory::Region::Count)> mapped_memory_reads_;
 	std::array<MemoryWriteFunction, static_cast<size_t>(Memory::Region::Count)> mapped_memory_writes_;
 	std::array<MemoryReadFunction, Memory::io_region_size_> mapped_io_register_reads_;
 	std::array<MemoryWriteFunction, Memory::io_region_size_> mapped_io_register_writes_;
 
+	std::array<const uint8_t*, 0x100> read_pages_{};
+	std::array<uint8_t*, 0x100> write_pages_{};
+	uint64_t mapping_generation_{ 0 };
+
+	// Watched WRAM pages are not directly writable, so that writes to them go through OnCodePageWritten
+	std::array<bool, 0x100> code_pages_{};
+	std::list<CodePageWriteListener> code_page_write_listeners_;
+
 	std::array<uint8_t, Memory::wram_size_> wram_;
 	std::array<uint8_t, Memory::hram_size_> hram_;
 
@@ -1,8 +1,26 @@
 #include "PPU.h"
 #include <string>
 #include <cassert>
-#include <set>
+#include <cstring>
 #include "MMU.h"
+#include "Scheduler.h"
+
+namespace
+{
+	// Spreads the 8 bits of a byte into 8 bytes (most significant bit first), so that the 8 pixels of a tile line can be decoded at once
+	constexpr auto pixel_bits_lut_ = []()
+	{
+		std::array<std::array<uint8_t, 8>, 256> lut{};
+		for (size_t value = 0; value < lut.size(); ++value)
+		{
+			for (size_t pixel = 0; pixel < 8; ++pixel)
+			{
+				lut[value][pixel] = (value >> (7 - pixel)) & 0x01;
+			}
+		}
+		return lut;
+	}();
+}
 
 PPU::PPU(MMU &mmu) :
 	bg_palette_{ Color::Black, Color::Black, Color::Black, Color::White },
@@ -11,6 +29,7 @@ PPU::PPU(MMU &mmu) :
 	mmu_(&mmu)
 {
 	bg_tile_map_occurrences_.fill(0);
+	sprites_to_render_this_line_.reserve(10);
 }
 
 void PPU::OnMachineCycleLapse()
@@ -39,9 +58,12 @@ void PPU::OnMachineCycleLapse()
 				if (clock_cycles_lapsed_in_state_ == oam_state_duration_)
 				{
 					clock_cycles_lapsed_in_state_ = 0;
-					sprites_to_render_this_line_ = ComputeSpritesToRender(current_line_);
+					ComputeSpritesToRender(current_line_);
 					scroll_x_delay_this_line_ = scroll_x_ & 0x07;
 					x_to_render_ = 0;
+					x_rendered_ = 0;
+					render_per_dot_this_line_ = (renderer_ == Renderer::PerDot);
+					mid_line_writes_this_line_ = false;
 					vram_duration_this_line_ = ComputeVramModeDuration();
 					next_state_ = State::VRAM;
 				}
@@ -52,14 +74,22 @@ void PPU::OnMachineCycleLapse()
 
 				if (x_to_render_ < 160)
 				{
-					RenderBackground(current_line_, x_to_render_);
-					RenderWindow(current_line_, x_to_render_);
+					// Otherwise, the pixels are rendered all at once when VRAM mode ends
+					if (render_per_dot_this_line_)
+					{
+						RenderBackground(current_line_, x_to_render_);
+						RenderWindow(current_line_, x_to_render_);
+						x_rendered_ = x_to_render_ + 1;
+					}
 
 					x_to_render_ += 1;
 				}
 
 				if (clock_cycles_lapsed_in_state_ == vram_duration_this_line_)
 				{
+					RenderPendingPixels();
+					rendering_statistics_.num_lines += 1;
+
 					clock_cycles_lapsed_in_state_ = 0;
 					hblank_duration_this_line_ = line_duration_ - oam_state_duration_ - vram_duration_this_line_;
 
@@ -176,6 +206,97 @@ void PPU::OnMachineCycleLapse()
 	}
 }
 
+void PPU::OnMachineCyclesLapsed(size_t num_machine_cycles)
+{
+	while (num_machine_cycles > 0)
+	{
+		const auto num_idle_machine_cycles = std::min(ComputeIdleMachineCycles(), num_machine_cycles);
+		if (num_idle_machine_cycles > 0)
+		{
+			LapseIdleMachineCycles(num_idle_machine_cycles);
+			num_machine_cycles -= num_idle_machine_cycles;
+		}
+		else
+		{
+			OnMachineCycleLapse();
+			num_machine_cycles -= 1;
+		}
+	}
+}
+
+size_t PPU::ComputeIdleMachineCycles() const
+{
+	// Nothing happens until the next event, except in the machine cycle of the event itself
+	const auto machine_cycles_until_next_event = GetMachineCyclesUntilNextEvent();
+	if (machine_cycles_until_next_event == Scheduler::no_event_) return machine_cycles_until_next_event;
+	if (machine_cycles_until_next_event <= 1) return 0;
+
+	// The STAT interrupt mode may differ from the current mode for one clock cycle, which must be processed cycle by cycle
+	if (stat_interrupt_mode_ != current_state_) return 0;
+
+	// Pixels rendered one by one
+	if ((current_state_ == State::VRAM) && render_per_dot_this_line_) return 0;
+
+	return machine_cycles_until_next_event - 1;
+}
+
+void PPU::LapseIdleMachineCycles(size_t num_machine_cycles)
+{
+	if (!lcd_on_) return;
+
+	const auto num_clock_cycles = 4 * num_machine_cycles;
+
+	if (current_state_ == State::VRAM)
+	{
+		// The beam advances one pixel per clock cycle, once the fine scroll delay has elapsed
+		const auto first_clock_cycle = std::max(clock_cycles_lapsed_in_state_, scroll_x_delay_this_line_);
+		const auto last_clock_cycle = clock_cycles_lapsed_in_state_ + num_clock_cycles;
+		if (last_clock_cycle > first_clock_cycle)
+		{
+			x_to_render_ = static_cast<uint8_t>(std::min<size_t>(160, x_to_render_ + (last_clock_cycle - first_clock_cycle)));
+		}
+	}
+
+	clock_cycles_lapsed_in_state_ += num_clock_cycles;
+	clock_cycles_lapsed_in_line_ += num_clock_cycles;
+}
+
+size_t PPU::GetMachineCyclesUntilNextEvent() const
+{
+	// OAM DMA reads from memory every machine cycle, so it must be kept in sync with the CPU
+	if ((oam_dma_.current_state_ != OamDma::State::Inactive) || (oam_dma_.next_state_ != OamDma::State::Inactive)) return 1;
+
+	if (!lcd_on_) return Scheduler::no_event_;
+
+	// Mode transitions and pending STAT interrupt line updates are processed cycle by cycle
+	if ((next_state_ != current_state_) || (line_coincidence_interrupt_delay_ > 0) || (IsStatInterruptRaised() != is_stat_interrupt_raised_)) return 1;
+
+	// Otherwise, the STAT interrupt line (and the VBlank interrupt) can only change when the current mode reaches its next checkpoint
+	size_t next_checkpoint{ 0 };
+	switch (current_state_)
+	{
+	case State::OAM:
+	case State::LcdTurnedOn:
+		next_checkpoint = oam_state_duration_;
+		break;
+	case State::VRAM:
+		next_checkpoint = vram_duration_this_line_;
+		break;
+	case State::HBLANK:
+		next_checkpoint = hblank_duration_this_line_;
+		break;
+	case State::VBLANK:
+		next_checkpoint = (clock_cycles_lapsed_in_state_ < 4) ? 4 : ((clock_cycles_lapsed_in_state_ < 8) ? 8 : line_duration_);
+		break;
+	default:
+		throw std::logic_error("Invalid current mode in GetMachineCyclesUntilNextEvent: " + std::to_string(static_cast<int>(current_state_)));
+	}
+
+	if (next_checkpoint <= clock_cycles_lapsed_in_state_) return 1;
+
+	return (next_checkpoint - clock_cycles_lapsed_in_state_ + 3) / 4;
+}
+
 void PPU::RenderBackground(uint8_t line_number, uint8_t x)
 {
 	if (!show_bg_) return;
@@ -187,7 +308,7 @@ void PPU::RenderBackground(uint8_t line_number, uint8_t x)
 	const auto tile_number = tile_maps_[active_bg_tile_map_][32 * (scrolled_y >> 3) + (scrolled_x >> 3)];
 
 	// Select tile depending on which tile set is currently active
-	const auto& tile = active_tile_set_ ? tile_set_[tile_number] : tile_set_[256 + static_cast<int8_t>(tile_number)];
+	const auto& tile = GetBgTile(tile_number);
 
 	// The values in the tile have already been computed from successive bytes in VRAM during OnVramWritten, and can directly be used
 	const auto color_number = tile[8 * (scrolled_y & 0x07) + (scrolled_x & 0x07)];
@@ -214,7 +335,7 @@ void PPU::RenderWindow(uint8_t line_number, uint8_t x)
 	auto tile_number = tile_maps_[active_window_tile_map_][32 * (window_line >> 3) + (window_x >> 3)];
 
 	// Select tile depending on which tile set is currently active
-	auto& tile = active_tile_set_ ? tile_set_[tile_number] : tile_set_[256 + static_cast<int8_t>(tile_number)];
+	const auto& tile = GetBgTile(tile_number);
 
 	// The values in the tile have already been computed from successive bytes in VRAM during OnVramWritten, and can directly be used
 	const auto color_number = tile[8 * (window_line & 0x07) + (window_x & 0x07)];
@@ -224,11 +345,125 @@ void PPU::RenderWindow(uint8_t line_number, uint8_t x)
 	framebuffer_[160 * line_number + x] = bg_palette_[color_number];
 }
 
-std::vector<size_t> PPU::ComputeSpritesToRender(uint8_t line_number) const
+void PPU::RenderBackgroundSpan(uint8_t line_number, uint8_t first_x, uint8_t end_x)
 {
-	if (!show_sprites_) return{};
+	if (!show_bg_) return;
 
-	std::vector<size_t> sprites_to_render;
+	const auto scrolled_y = static_cast<uint8_t>(line_number + scroll_y_);
+	const auto &tile_map = tile_maps_[active_bg_tile_map_];
+	const auto tile_map_row = 32 * (scrolled_y >> 3);
+	const auto tile_line = 8 * (scrolled_y & 0x07);
+
+	// Render tile by tile, so that each tile is only looked up once
+	for (auto x = first_x; x < end_x;)
+	{
+		const auto scrolled_x = static_cast<uint8_t>(x + scroll_x_);
+		const auto &tile = GetBgTile(tile_map[tile_map_row + (scrolled_x >> 3)]);
+
+		for (auto tile_x = scrolled_x & 0x07; (tile_x < 8) && (x < end_x); ++tile_x, ++x)
+		{
+			const auto color_number = tile[tile_line + tile_x];
+			is_bg_transparent_[160 * line_number + x] = (color_number == 0);
+			framebuffer_[160 * line_number + x] = bg_palette_[color_number];
+		}
+	}
+
+	bg_tile_map_occurrences_[active_bg_tile_map_] += end_x - first_x;
+}
+
+void PPU::RenderWindowSpan(uint8_t line_number, uint8_t first_x, uint8_t end_x)
+{
+	if (!show_window_) return;
+
+	if (line_number < window_y_) return;
+	if (end_x <= window_x_) return;
+
+	const auto window_line = static_cast<uint8_t>(line_number - window_y_);
+	const auto &tile_map = tile_maps_[active_window_tile_map_];
+	const auto tile_map_row = 32 * (window_line >> 3);
+	const auto tile_line = 8 * (window_line & 0x07);
+
+	for (int x = std::max<int>(first_x, window_x_); x < end_x;)
+	{
+		const auto window_x = x - window_x_;
+		const auto &tile = GetBgTile(tile_map[tile_map_row + (window_x >> 3)]);
+
+		for (auto tile_x = window_x & 0x07; (tile_x < 8) && (x < end_x); ++tile_x, ++x)
+		{
+			const auto color_number = tile[tile_line + tile_x];
+			is_bg_transparent_[160 * line_number + x] = (color_number == 0);
+			framebuffer_[160 * line_number + x] = bg_palette_[color_number];
+		}
+	}
+}
+
+void PPU::RenderSpan(uint8_t first_x, uint8_t end_x)
+{
+	if (first_x >= end_x) return;
+
+	RenderBackgroundSpan(current_line_, first_x, end_x);
+	RenderWindowSpan(current_line_, first_x, end_x);
+}
+
+void PPU::RenderPendingPixels()
+{
+	// Registers hold the values written last, so the segments between mid-line writes are rendered right to left, undoing each write on the way
+	auto end_x = x_to_render_;
+	for (auto i = num_mid_line_writes_; i > 0; --i)
+	{
+		const auto &mid_line_write = mid_line_writes_[i - 1];
+		RenderSpan(mid_line_write.x, end_x);
+		WriteRenderingRegister(mid_line_write.address, mid_line_write.previous_value);
+		end_x = mid_line_write.x;
+	}
+	RenderSpan(x_rendered_, end_x);
+
+	// Then the writes are redone, in order
+	for (size_t i = 0; i < num_mid_line_writes_; ++i)
+	{
+		WriteRenderingRegister(mid_line_writes_[i].address, mid_line_writes_[i].value);
+	}
+
+	num_mid_line_writes_ = 0;
+	x_rendered_ = x_to_render_;
+}
+
+void PPU::DecodeTile(size_t tile_index)
+{
+	auto &tile = tile_set_[tile_index];
+	const auto *tile_data = &vram_[16 * tile_index];
+
+	// Pixel values in each line are computed by combining the pertinent bit of two consecutive bytes in VRAM.
+	// Spread bits are 0 or 1 in each byte, so all 8 pixels can be combined at once in a 64-bit integer, regardless of the endianness.
+	for (size_t line_in_tile = 0; line_in_tile < 8; ++line_in_tile)
+	{
+		uint64_t low_bits, high_bits;
+		std::memcpy(&low_bits, pixel_bits_lut_[tile_data[2 * line_in_tile]].data(), sizeof(low_bits));
+		std::memcpy(&high_bits, pixel_bits_lut_[tile_data[2 * line_in_tile + 1]].data(), sizeof(high_bits));
+
+		const auto pixels = low_bits | (high_bits << 1);
+		std::memcpy(&tile[8 * line_in_tile], &pixels, sizeof(pixels));
+	}
+
+	dirty_tiles_[tile_index >> 6] &= ~(uint64_t{ 1 } << (tile_index & 0x3F));
+}
+
+void PPU::DecodeDirtyTiles()
+{
+	for (size_t word_index = 0; word_index < dirty_tiles_.size(); ++word_index)
+	{
+		for (size_t tile_index = 64 * word_index; dirty_tiles_[word_index] != 0; ++tile_index)
+		{
+			if (IsTileDirty(tile_index)) DecodeTile(tile_index);
+		}
+	}
+}
+
+void PPU::ComputeSpritesToRender(uint8_t line_number)
+{
+	sprites_to_render_this_line_.clear();
+
+	if (!show_sprites_) return;
 
 	// Only 10 sprites can be displayed on any one line, prioritized by address (i.e. 0xFE00 highest, 0xFE04 next highest, etc.)
 	// When this limit is exceeded, the lower priority sprites won't be displayed
@@ -236,35 +471,23 @@ std::vector<size_t> PPU::ComputeSpritesToRender(uint8_t line_number) const
 	//   Sprites with lower x coordinate (closer to the left) have higher priority and appear above any others
 	//   When sprites with the same x coordinate values overlap, they have priority according to table ordering (i.e. 0xFE00 highest, 0xFE04 next highest, etc.)
 
-	//TODO: precompute sprites priority when OAM is written? That may perform better than rechecking priority every time
-
-	// First, filter the sprites to be rendered in the current scanline
-	for (int i = 0; i < sprites_.size(); ++i)
+	// First, take the sprites to be rendered in the current scanline from its bucket, in OAM order
+	// The sprites beyond the screen width are skipped, since they don't add up any cycles to VRAM duration nor do they need to be drawn, but they still count towards the limit
+	auto line_bucket = line_buckets_[sprite_height_ >> 4][line_number];
+	for (size_t i = 0, num_sprites = 0; (line_bucket != 0) && (num_sprites < 10); ++i, line_bucket >>= 1)
 	{
-		// Verify if it has to be rendered in the current scanline
-		if ((line_number < sprites_[i].GetY()) || (line_number >= (sprites_[i].GetY() + sprite_height_))) { continue; }
-
-		sprites_to_render.emplace_back(i);
+		if ((line_bucket & 0x01) == 0) continue;
 
-		if (sprites_to_render.size() == 10) break;
+		num_sprites += 1;
+		if (sprites_[i].GetX() < 160) sprites_to_render_this_line_.emplace_back(i);
 	}
 
-	// Remove the sprites beyond the screen width, since they don't add up any cycles to VRAM duration nor do they need to be drawn
-	sprites_to_render.erase(std::remove_if(sprites_to_render.begin(), sprites_to_render.end(), [this](size_t index) {
-		return (sprites_[index].GetX() >= 160);
-	}), sprites_to_render.end());
-
-	// Return if there are no sprites to render
-	if (sprites_to_render.empty()) return{};
-
-	// Now sort the remaining sprites according to rendering priority: draw higher X (or higher address, if equals X) sprites first (i.e. from right to left)
+	// Now sort the sprites according to rendering priority: draw higher X (or higher address, if equals X) sprites first (i.e. from right to left)
 	// This way, in the final image the sprites with lower X and lower address will appear above the rest
-	std::sort(sprites_to_render.begin(), sprites_to_render.end(), [this](size_t lhs_index, size_t rhs_index) {
+	std::sort(sprites_to_render_this_line_.begin(), sprites_to_render_this_line_.end(), [this](size_t lhs_index, size_t rhs_index) {
 		return sprites_[lhs_index].GetX() > sprites_[rhs_index].GetX()
 			|| ((sprites_[lhs_index].GetX() == sprites_[rhs_index].GetX()) && (lhs_index > rhs_index));
 	});
-
-	return sprites_to_render;
 }
 
 size_t PPU::ComputeVramModeDuration() const
@@ -277,14 +500,12 @@ size_t PPU::ComputeVramModeDuration() const
 	vram_duration_this_line += sprites_to_render_this_line_.size() * 6; // (sprites_to_render_this_line_.size() << 2) + ((sprites_to_render_this_line_.size() >> 1) << 2);
 
 	// Each unique X coordinate among the sprites adds a number of clock cycles, depending on the X coordinate in modulo 8
-	std::set<int> x_coordinates;
-	for (auto sprite_index : sprites_to_render_this_line_)
+	// Sprites are sorted by X coordinate, so equal coordinates are next to each other
+	for (size_t i = 0; i < sprites_to_render_this_line_.size(); ++i)
 	{
-		x_coordinates.insert(sprites_[sprite_index].GetX());
-	}
+		const auto x = sprites_[sprites_to_render_this_line_[i]].GetX();
+		if ((i > 0) && (x == sprites_[sprites_to_render_this_line_[i - 1]].GetX())) continue;
 
-	for (auto x : x_coordinates)
-	{
 		vram_duration_this_line += std::max(5 - (x & 0x07), 0);
 	}
 
@@ -302,8 +523,8 @@ void PPU::RenderSprites(uint8_t line_number)
 		if (sprite.IsVerticallyFlipped()) tile_line = (sprite_height_ - 1) - tile_line;
 
 		// 16 pixel height sprites' first tile number is retrieved by resetting the lowest bit; the second tile number is retrieved by setting it.
-		const auto& tile = ((sprite_height_ >> 4) == 0) ? tile_set_[sprite.GetTileNumber()]
-			: (tile_line < 8 ? tile_set_[sprite.GetTileNumber() & 0xFE] : tile_set_[sprite.GetTileNumber() | 0x01]);
+		const auto& tile = GetTile(((sprite_height_ >> 4) == 0) ? sprite.GetTileNumber()
+			: (tile_line < 8 ? (sprite.GetTileNumber() & 0xFE) : (sprite.GetTileNumber() | 0x01)));
 		tile_line &= 0x07;
 
 		uint8_t color_number{ 0 };
@@ -401,19 +622,9 @@ void PPU::OnVramWritten(Memory::Address address, uint8_t value)
 
 	if (relative_address < tile_map_0_offset_)
 	{
-		// Select tile from set, taking into account each tile is 16 bytes in size
-		auto& tile = tile_set_[relative_address >> 4];
-
-		// Pixel values in the tile are computed by combining the pertinent bit of two consecutive bytes in VRAM
-		// Therefore updating one byte in VRAM will change the value of all 8 pixels in one line of the tile
-		const auto line_in_tile = (relative_address & 0x0F) >> 1;
-		for (int i = 0; i < 8; ++i)
-		{
-			const auto pixel_mask = (0x80 >> i);
-			const auto pixel_low_bit = (vram_[relative_address & 0xFFFE] & pixel_mask) != 0 ? 1 : 0;
-			const auto pixel_high_bit = (vram_[(relative_address & 0xFFFE) + 1] & pixel_mask) != 0 ? 1 : 0;
-			tile[8 * line_in_tile + i] = static_cast<uint8_t>(pixel_low_bit + (pixel_high_bit << 1));
-		}
+		// Tiles are 16 bytes in size, and only decoded when sampled
+		const auto tile_index = relative_address >> 4;
+		dirty_tiles_[tile_index >> 6] |= uint64_t{ 1 } << (tile_index & 0x3F);
 	}
 	else if (relative_address < tile_map_1_offset_)
 	{
@@ -502,18 +713,22 @@ void PPU::OnIoMemoryWritten(Memory::Address address, uint8_t value)
 	switch (address)
 	{
 	case Memory::LCDC:
-		SetLcdControl(value);
+	case Memory::SCY:
+	case Memory::SCX:
+	case Memory::BGP:
+	case Memory::WY:
+	case Memory::WX:
+		// The line has already been rendered if VRAM mode ended in the last clock cycle
+		if ((current_state_ == State::VRAM) && (next_state_ == State::VRAM)) OnMidLineWrite(address, value);
+		WriteRenderingRegister(address, value);
 		break;
 	case Memory::STAT:
 		SetLcdStatus(value);
 		break;
-	case Memory::SCY:
-		scroll_y_ = value;
-		break;
-	case Memory::SCX:
-		scroll_x_ = value;
-		break;
 	case Memory::LY:
+		// The line being drawn is left as is
+		RenderPendingPixels();
+
 		// Writing into this register resets the line counter
 		current_line_ = 0;
 
@@ -532,15 +747,33 @@ void PPU::OnIoMemoryWritten(Memory::Address address, uint8_t value)
 		oam_dma_.next_state_ = OamDma::State::Startup;
 		oam_dma_.source_ = value << 8;
 		break;
-	case Memory::BGP:
-		SetPaletteData(bg_palette_, value);
-		break;
 	case Memory::OBP0:
 		SetPaletteData(obj_palettes_[0], value);
 		break;
 	case Memory::OBP1:
 		SetPaletteData(obj_palettes_[1], value);
 		break;
+	default:
+		throw std::invalid_argument{ "Writing to invalid memory address in PPU: " + std::to_string(address) };
+	}
+}
+
+void PPU::WriteRenderingRegister(Memory::Address address, uint8_t value)
+{
+	switch (address)
+	{
+	case Memory::LCDC:
+		SetLcdControl(value);
+		break;
+	case Memory::SCY:
+		scroll_y_ = value;
+		break;
+	case Memory::SCX:
+		scroll_x_ = value;
+		break;
+	case Memory::BGP:
+		SetPaletteData(bg_palette_, value);
+		break;
 	case Memory::WY:
 		window_y_ = value;
 		break;
@@ -548,10 +781,39 @@ void PPU::OnIoMemoryWritten(Memory::Address address, uint8_t value)
 		window_x_ = value - 7;
 		break;
 	default:
-		throw std::invalid_argument{ "Writing to invalid memory address in PPU: " + std::to_string(address) };
+		throw std::invalid_argument{ "Writing to invalid rendering register in PPU: " + std::to_string(address) };
 	}
 }
 
+void PPU::OnMidLineWrite(Memory::Address address, uint8_t value)
+{
+	rendering_statistics_.num_mid_line_writes += 1;
+	if (!mid_line_writes_this_line_)
+	{
+		mid_line_writes_this_line_ = true;
+		rendering_statistics_.num_lines_with_mid_line_writes += 1;
+	}
+
+	const auto previous_value = OnIoMemoryRead(address);
+
+	// Turning the LCD off ends the line right away, so it cannot be logged
+	const auto is_lcd_turned_off = (address == Memory::LCDC) && ((value & 0x80) == 0);
+
+	if ((renderer_ == Renderer::Segmented) && !is_lcd_turned_off)
+	{
+		// The log is rendered in advance if full
+		if (num_mid_line_writes_ == mid_line_writes_.size()) RenderPendingPixels();
+
+		mid_line_writes_[num_mid_line_writes_++] = { x_to_render_, address, previous_value, value };
+		return;
+	}
+
+	// Otherwise, the pixels up to the current position are rendered with the previous register values,
+	// and the scanline renderer renders the rest of the line per dot
+	RenderPendingPixels();
+	if (renderer_ == Renderer::Scanline) render_per_dot_this_line_ = true;
+}
+
 void PPU::WriteOam(size_t index, uint8_t value)
 {
 	oam_[index] = value;
@@ -563,7 +825,9 @@ void PPU::WriteOam(size_t index, uint8_t value)
 	switch (index & 0x03)
 	{
 	case 0:
+		SetSpriteInLineBuckets(sprite_num, false);
 		sprites_[sprite_num].SetY(value);
+		SetSpriteInLineBuckets(sprite_num, true);
 		break;
 	case 1:
 		sprites_[sprite_num].SetX(value);
@@ -576,6 +840,36 @@ void PPU::WriteOam(size_t index, uint8_t value)
 		break;
 	}
 }
+
+void PPU::SetSpriteInLineBuckets(size_t sprite_index, bool is_in_line_buckets)
+{
+	const auto sprite_mask = uint64_t{ 1 } << sprite_index;
+	const auto y = sprites_[sprite_index].GetY();
+
+	for (size_t height_index = 0; height_index < line_buckets_.size(); ++height_index)
+	{
+		auto &line_buckets = line_buckets_[height_index];
+		const auto end_line = std::min<int>(y + (8 << height_index), static_cast<int>(line_buckets.size()));
+		for (auto line = std::max(y, 0); line < end_line; ++line)
+		{
+			if (is_in_line_buckets) line_buckets[line] |= sprite_mask;
+			else line_buckets[line] &= ~sprite_mask;
+		}
+	}
+}
+
+void PPU::RebuildLineBuckets()
+{
+	for (auto &line_buckets : line_buckets_)
+	{
+		line_buckets.fill(0);
+	}
+
+	for (size_t sprite_index = 0; sprite_index < sprites_.size(); ++sprite_index)
+	{
+		SetSpriteInLineBuckets(sprite_index, true);
+	}
+}
 #pragma endregion
 
 #pragma region Listeners
@@ -35,17 +35,37 @@ public:
 	};
 
 	using Framebuffer = std::array<Color, 160 * 144>;
+
+	// 154 lines of 456 clock cycles, whether the LCD is on or not
+	static constexpr size_t frame_duration_{ 154 * 456 };
 	using Tile = std::array<uint8_t, 8 * 8>;
 	using Tileset = std::array<Tile, 384>;
 	using TileMap = std::array<uint8_t, 32 * 32>;
 	using Palette = std::array<Color, 4>;
 
+	enum class Renderer
+	{
+		PerDot,		// Background and window pixels are rendered one by one, as VRAM mode goes on
+		Scanline,	// Background and window pixels are rendered all at once when VRAM mode ends, unless some registers are written in the middle of the line
+		Segmented,	// Same as Scanline, but registers written in the middle of the line are logged, and the line is rendered in segments of constant register values
+	};
+
+	// How often registers used for rendering are written in the middle of a line, regardless of the renderer
+	struct RenderingStatistics
+	{
+		uint64_t num_lines{ 0 };
+		uint64_t num_lines_with_mid_line_writes{ 0 };
+		uint64_t num_mid_line_writes{ 0 };
+	};
+
 public:
 	PPU(MMU &mmu);
 	virtual ~PPU() = default;
 
-	// CPU::Listener overrides
+	// Scheduler functions
 	void OnMachineCycleLapse();
+	void OnMachineCyclesLapsed(size_t num_machine_cycles);
+	size_t GetMachineCyclesUntilNextEvent() const;
 
 	// MMU mapped memory read/write functions
 	uint8_t OnVramRead(Memory::Address address) const;
@@ -59,9 +79,15 @@ public:
 	using Listener = std::function<void()>;
 	std::function<void()> AddNewFrameListener(Listener &&listener);
 
+	// Rendering mode
+	void SetRenderer(Renderer renderer) { renderer_ = renderer; }
+	Renderer GetRenderer() const { return renderer_; }
+	const RenderingStatistics& GetRenderingStatistics() const { return rendering_statistics_; }
+
 	// GUI interaction
+	// Note that, with the scanline renderer, the line currently being drawn (if any) is only completed when VRAM mode ends
 	const Framebuffer& GetFramebuffer() const { return framebuffer_; }
-	const Tileset& GetTileSet() const { return tile_set_; }
+	const Tileset& GetTileSet() { DecodeDirtyTiles(); return tile_set_; }
 	const TileMap& GetTileMap(size_t tile_map) const { return tile_maps_[tile_map]; }
 	size_t GetDetectedActiveBackgroundTileMap() const { return std::distance(bg_tile_map_occurrences_.begin(), std::max_element(bg_tile_map_occurrences_.begin(), bg_tile_map_occurrences_.end())); }
 	size_t GetActiveTileSet() const { return active_tile_set_; }
@@ -70,10 +96,18 @@ public:
 	void serialize(Archive &archive);
 
 private:
+	// Machine cycles in which only the cycle counters (and the position of the "beam") change
+	size_t ComputeIdleMachineCycles() const;
+	void LapseIdleMachineCycles(size_t num_machine_cycles);
+
 	// Rendering
 	void RenderBackground(uint8_t line_number, uint8_t x);
 	void RenderWindow(uint8_t line_number, uint8_t x);
-	std::vector<size_t> ComputeSpritesToRender(uint8_t line_number) const;
+	void RenderBackgroundSpan(uint8_t line_number, uint8_t first_x, uint8_t end_x);
+	void RenderWindowSpan(uint8_t line_number, uint8_t first_x, uint8_t end_x);
+	void RenderSpan(uint8_t first_x, uint8_t end_x);
+	void RenderPendingPixels();
+	void ComputeSpritesToRender(uint8_t line_number);
 	size_t ComputeVramModeDuration() const;
 	void RenderSprites(uint8_t line_number);
 
@@ -81,11 +115,22 @@ private:
 	void SetLcdControl(uint8_t value);
 	void SetLcdStatus(uint8_t value);
 	void SetPaletteData(Palette &palette, uint8_t value);
+	void WriteRenderingRegister(Memory::Address address, uint8_t value);
+	void OnMidLineWrite(Memory::Address address, uint8_t value);
+
+	// Tile decoding
+	void DecodeTile(size_t tile_index);
+	void DecodeDirtyTiles();
+	inline bool IsTileDirty(size_t tile_index) const { return ((dirty_tiles_[tile_index >> 6] >> (tile_index & 0x3F)) & 0x01) != 0; }
+	inline const Tile& GetTile(size_t tile_index) { if (IsTileDirty(tile_index)) DecodeTile(tile_index); return tile_set_[tile_index]; }
+	inline const Tile& GetBgTile(uint8_t tile_number) { return active_tile_set_ ? GetTile(tile_number) : GetTile(256 + static_cast<int8_t>(tile_number)); }
 
 	// Helper functions
 	void EnableLcd(bool enabled);
 	uint8_t GetPaletteData(const Palette &palette) const;
 	void WriteOam(size_t index, uint8_t value);
+	void SetSpriteInLineBuckets(size_t sprite_index, bool is_in_line_buckets);
+	void RebuildLineBuckets();
 	inline bool CompareCurrentLine() const { return (stat_interrupt_line_ == line_compare_) && (line_coincidence_interrupt_delay_ == 0); }
 	inline bool IsLineCoincidenceInterruptRaised() const { return line_coincidence_interrupt_enabled_ && CompareCurrentLine(); }
 	inline bool IsOamInterruptRaised() const { return oam_interrupt_enabled_ && (stat_interrupt_mode_ == State::OAM); }
@@ -118,6 +163,24 @@ private:
 	size_t scroll_x_delay_this_line_{ 0 };
 	uint8_t x_to_render_{ 0 };
 
+	// Scanline renderer
+	Renderer renderer_{ Renderer::Segmented };
+	bool render_per_dot_this_line_{ false }; // Set when registers used for rendering are written in the middle of the line
+	uint8_t x_rendered_{ 0 }; // Pixels [0, x_rendered_) of the current line are already in the framebuffer, while x_to_render_ is the position of the "beam"
+
+	// Registers written in the middle of the current line, pending to be rendered by the segmented renderer
+	struct MidLineWrite
+	{
+		uint8_t x;	// Position of the "beam" when written
+		Memory::Address address;
+		uint8_t previous_value;
+		uint8_t value;
+	};
+	std::array<MidLineWrite, 16> mid_line_writes_{};
+	size_t num_mid_line_writes_{ 0 };
+	bool mid_line_writes_this_line_{ false };
+	RenderingStatistics rendering_statistics_;
+
 	// LCD Control register values
 	bool show_bg_{ true };					// bit 0
 	bool show_sprites_{ false };			// bit 1
@@ -153,11 +216,15 @@ private:
 	std::array<uint8_t, Memory::vram_size_> vram_{};
 	std::array<uint8_t, Memory::oam_size_> oam_{};
 	Tileset tile_set_{};
+	std::array<uint64_t, 384 / 64> dirty_tiles_{}; // Bitmap of the tiles written in VRAM since they were last decoded into tile_set_
 
 	std::array<TileMap, 2> tile_maps_{};
 
 	std::array<Sprite, 40> sprites_{};
-	std::vector<size_t> sprites_to_render_this_line_;
+	std::vector<size_t> sprites_to_render_this_line_; // Up to 10 sprites, with its capacity reserved upfront
+
+	// Bitmap of the sprites (by OAM index) overlapping each line, for 8 and 16 pixel height sprites, updated when OAM is written
+	std::array<std::array<uint64_t, 144>, 2> line_buckets_{};
 
 	Framebuffer framebuffer_{};
 	std::array<bool, 160 * 144> is_bg_transparent_{}; // Color number 0 on background is "transparent" and therefore sprites show on top of it
@@ -193,10 +260,19 @@ private:
 template<class Archive>
 void PPU::serialize(Archive & archive)
 {
+	// Make the framebuffer up to date, as the per dot renderer would have left it (there is no point in doing so for the state about to be loaded)
+	if (Archive::is_saving::value)
+	{
+		RenderPendingPixels();
+		DecodeDirtyTiles();
+	}
+
 	archive(current_state_, next_state_);
-	archive(clock_cycles_lapsed_in_state_, clock_cycles_lapsed_in_line_, vram_duration_this_line_, hblank_duration_this_line_);
+	archive(clock_cycles_lapsed_in_state_, clock_cycles_lapsed_in_line_, vram_duration_this_line_, hblank_duration_this_line_, scroll_x_delay_this_line_, x_to_render_);
+	archive(render_per_dot_this_line_, x_rendered_, num_mid_line_writes_, mid_line_writes_this_line_);
 	archive(show_bg_, show_sprites_, sprite_height_, active_bg_tile_map_, active_tile_set_, show_window_, active_window_tile_map_, lcd_on_);
 	archive(hblank_interrupt_enabled_, vblank_interrupt_enabled_, oam_interrupt_enabled_, line_coincidence_interrupt_enabled_);
+	archive(is_stat_interrupt_raised_, line_coincidence_interrupt_delay_, stat_interrupt_mode_, stat_interrupt_line_);
 	archive(scroll_y_, scroll_x_, current_line_, line_compare_);
 	archive(bg_palette_, obj_palettes_);
 	archive(window_y_, window_x_);
@@ -205,4 +281,11 @@ void PPU::serialize(Archive & archive)
 	archive(sprites_, sprites_to_render_this_line_);
 	archive(framebuffer_, is_bg_transparent_);
 	archive(oam_dma_.current_state_, oam_dma_.next_state_, oam_dma_.source_, oam_dma_.current_byte_index_);
+
+	if (Archive::is_loading::value)
+	{
+		// The loaded tile set was saved up to date with the loaded VRAM
+		dirty_tiles_.fill(0);
+		RebuildLineBuckets();
+	}
 }
@@ -0,0 +1,100 @@
+#include "RewindBuffer.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+RewindBuffer::RewindBuffer(size_t memory_budget, size_t keyframe_interval) :
+	memory_budget_{ memory_budget },
+	keyframe_interval_{ keyframe_interval }
+{
+	if (keyframe_interval == 0) { throw std::invalid_argument{ "Invalid rewind keyframe interval: " + std::to_string(keyframe_interval) }; }
+}
+
+void RewindBuffer::Push(const JucyBoy::Snapshot &snapshot)
+{
+	// Deltas need a reference of the same size
+	const auto is_keyframe = entries_.empty() || (num_entries_since_keyframe_ >= keyframe_interval_) || (snapshot.GetSize() != newest_snapshot_.size());
+
+	Encode(snapshot.GetData(), is_keyframe ? nullptr : newest_snapshot_.data(), snapshot.GetSize(), encoded_data_);
+	entries_.push_back({ std::vector<uint8_t>(encoded_data_.begin(), encoded_data_.end()), snapshot.GetSize(), is_keyframe });
+	memory_usage_ += GetEntryMemoryUsage(entries_.back());
+	num_entries_since_keyframe_ = is_keyframe ? 1 : num_entries_since_keyframe_ + 1;
+
+	newest_snapshot_.assign(snapshot.GetData(), snapshot.GetData() + snapshot.GetSize());
+
+	PopOldestEntries();
+}
+
+bool RewindBuffer::Rewind(size_t num_snapshots_back, JucyBoy::Snapshot &snapshot)
+{
+	if (entries_.empty()) return false;
+
+	const auto target_index = entries_.size() - 1 - std::min(num_snapshots_back, entries_.size() - 1);
+	if (target_index != entries_.size() - 1)
+	{
+		while (entries_.size() > target_index + 1) PopNewestEntry();
+
+		// The oldest entry is always a keyframe
+		auto keyframe_index = target_index;
+		while (!entries_[keyframe_index].is_keyframe) --keyframe_index;
+
+		newest_snapshot_.assign(entries_[target_index].snapshot_size, 0);
+		for (auto index = keyframe_index; index <= target_index; ++index)
+		{
+			DecodeXor(entries_[index].encoded_data, newest_snapshot_.data(), newest_snapshot_.size());
+		}
+		num_entries_since_keyframe_ = target_index - keyframe_index + 1;
+	}
+
+	snapshot.Assign(newest_snapshot_.data(), newest_snapshot_.size());
+	return true;
+}
+
+void RewindBuffer::Clear()
+{
+	entries_.clear();
+	memory_usage_ = 0;
+	num_entries_since_keyframe_ = 0;
+	newest_snapshot_.clear();
+}
+
+void RewindBuffer::Encode(const uint8_t *data, const uint8_t *reference, size_t size, std::vector<uint8_t> &encoded_data)
+{
+	encoded_data.clear();
+	if (reference == nullptr)
+	{
+		codec_.Encode(data, size, encoded_data);
+		return;
+	}
+
+	delta_.resize(size);
+	for (size_t index = 0; index < size; ++index) delta_[index] = data[index] ^ reference[index];
+	codec_.Encode(delta_.data(), size, encoded_data);
+}
+
+void RewindBuffer::DecodeXor(const std::vector<uint8_t> &encoded_data, uint8_t *data, size_t size)
+{
+	delta_.resize(size);
+	LzCodec::Decode(encoded_data.data(), encoded_data.size(), delta_.data(), size);
+	for (size_t index = 0; index < size; ++index) data[index] ^= delta_[index];
+}
+
+void RewindBuffer::PopOldestEntries()
+{
+	const auto memory_budget = memory_budget_.load();
+	while ((memory_usage_ > memory_budget) && (entries_.size() > num_entries_since_keyframe_))
+	{
+		// The deltas after the oldest keyframe can not be decoded without it, so they go too
+		do
+		{
+			memory_usage_ -= GetEntryMemoryUsage(entries_.front());
+			entries_.pop_front();
+		} while (!entries_.front().is_keyframe);
+	}
+}
+
+void RewindBuffer::PopNewestEntry()
+{
+	memory_usage_ -= GetEntryMemoryUsage(entries_.back());
+	entries_.pop_back();
+}
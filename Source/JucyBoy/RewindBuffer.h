@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "JucyBoy.h"
+#include "LzCodec.h"
+
+// Memory-bounded history of snapshots, for rewinding.
+// Each snapshot is stored as its XOR delta against the previous one (mostly zeros, since little of the machine state changes between snapshots), LZ compressed (see LzCodec).
+// Every keyframe_interval snapshots (and whenever the snapshot size changes), a keyframe is stored instead: the snapshot itself, LZ compressed.
+// Restoring a snapshot decodes the keyframe before it, then applies the deltas up to it.
+// When the memory budget is exceeded, the oldest snapshots are dropped, a keyframe and its deltas at a time (the newest keyframe and its deltas are always kept).
+class RewindBuffer final
+{
+public:
+	RewindBuffer(size_t memory_budget, size_t keyframe_interval);
+	~RewindBuffer() = default;
+
+	// Can be changed from any thread, and is enforced on the next push
+	void SetMemoryBudget(size_t memory_budget) { memory_budget_.store(memory_budget); }
+	size_t GetMemoryBudget() const { return memory_budget_.load(); }
+
+	void Push(const JucyBoy::Snapshot &snapshot);
+
+	// Restores the snapshot pushed the given number of pushes before the newest one (or the oldest one, if there are not that many).
+	// The snapshots newer than the restored one are dropped, so that history carries on from it. Returns false if there are no snapshots.
+	bool Rewind(size_t num_snapshots_back, JucyBoy::Snapshot &snapshot);
+
+	void Clear();
+
+	size_t GetNumSnapshots() const { return entries_.size(); }
+	size_t GetMemoryUsage() const { return memory_usage_; }
+
+private:
+	struct Entry
+	{
+		std::vector<uint8_t> encoded_data;
+		size_t snapshot_size;
+		bool is_keyframe;
+	};
+
+	// Encoding of the XOR of data and reference (or of data alone, without a reference)
+	void Encode(const uint8_t *data, const uint8_t *reference, size_t size, std::vector<uint8_t> &encoded_data);
+	void DecodeXor(const std::vector<uint8_t> &encoded_data, uint8_t *data, size_t size);
+
+	static size_t GetEntryMemoryUsage(const Entry &entry) { return sizeof(Entry) + entry.encoded_data.capacity(); }
+	void PopOldestEntries();
+	void PopNewestEntry();
+
+	std::atomic<size_t> memory_budget_;
+	const size_t keyframe_interval_;
+
+	std::deque<Entry> entries_;
+	size_t memory_usage_{ 0 };
+	size_t num_entries_since_keyframe_{ 0 }; // Including the keyframe itself
+
+	std::vector<uint8_t> newest_snapshot_;	// Reference of the next delta
+
+	// Scratch buffers, so that only the stored entries allocate
+	std::vector<uint8_t> encoded_data_;
+	std::vector<uint8_t> delta_;
+	LzCodec codec_;
+};
@@ -0,0 +1,141 @@
+#include "RomImage.h"
+#include "Fnv1aHash.h"
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	struct SharedImage
+	{
+		std::weak_ptr<const RomImage> image;
+		std::uintmax_t file_size;
+		std::filesystem::file_time_type last_write_time;
+	};
+
+	std::mutex shared_images_mutex;
+	std::map<std::filesystem::path, SharedImage> shared_images; // By canonical file path
+}
+
+std::shared_ptr<const RomImage> RomImage::Open(const std::string &rom_file_path)
+{
+	std::error_code error_code;
+	auto file_path = std::filesystem::canonical(rom_file_path, error_code);
+	if (error_code) { throw std::runtime_error{ "ROM file could not be opened" }; }
+
+	const auto file_size = std::filesystem::file_size(file_path, error_code);
+	const auto last_write_time = std::filesystem::last_write_time(file_path, error_code);
+	if (error_code) { throw std::runtime_error{ "ROM file could not be opened" }; }
+
+	std::lock_guard<std::mutex> lock{ shared_images_mutex };
+	for (auto it = shared_images.begin(); it != shared_images.end();)
+	{
+		it = it->second.image.expired() ? shared_images.erase(it) : std::next(it);
+	}
+
+	auto &shared_image = shared_images[file_path];
+	auto image = shared_image.image.lock();
+	if ((image == nullptr) || (shared_image.file_size != file_size) || (shared_image.last_write_time != last_write_time))
+	{
+		// The constructor is private, so std::make_shared can not be used
+		image = std::shared_ptr<const RomImage>{ new RomImage{ file_path.string() } };
+		shared_image = { image, file_size, last_write_time };
+	}
+	return image;
+}
+
+#ifdef _WIN32
+RomImage::RomImage(const std::string &rom_file_path)
+{
+	const auto file_handle = CreateFileW(std::filesystem::path{ rom_file_path }.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file_handle == INVALID_HANDLE_VALUE) { throw std::runtime_error{ "ROM file could not be opened" }; }
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file_handle, &file_size))
+	{
+		CloseHandle(file_handle);
+		throw std::runtime_error{ "ROM file could not be opened" };
+	}
+	size_ = static_cast<size_t>(file_size.QuadPart);
+
+	// Empty files can not be mapped (and are no valid ROM anyway)
+	if (size_ != 0)
+	{
+		// The mapping keeps the file open
+		file_mapping_handle_ = CreateFileMappingW(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file_handle);
+		if (file_mapping_handle_ == nullptr) { throw std::runtime_error{ "ROM file could not be mapped" }; }
+
+		data_ = static_cast<const uint8_t*>(MapViewOfFile(file_mapping_handle_, FILE_MAP_READ, 0, 0, 0));
+		if (data_ == nullptr)
+		{
+			CloseHandle(file_mapping_handle_);
+			throw std::runtime_error{ "ROM file could not be mapped" };
+		}
+	}
+	else
+	{
+		CloseHandle(file_handle);
+	}
+
+	hash_ = GetFnv1aHash(data_, size_);
+}
+
+RomImage::~RomImage()
+{
+	if (data_ != nullptr) UnmapViewOfFile(data_);
+	if (file_mapping_handle_ != nullptr) CloseHandle(file_mapping_handle_);
+}
+#else
+RomImage::RomImage(const std::string &rom_file_path)
+{
+	const auto file_descriptor = open(rom_file_path.c_str(), O_RDONLY);
+	if (file_descriptor < 0) { throw std::runtime_error{ "ROM file could not be opened" }; }
+
+	struct stat file_status;
+	if (fstat(file_descriptor, &file_status) != 0)
+	{
+		close(file_descriptor);
+		throw std::runtime_error{ "ROM file could not be opened" };
+	}
+	size_ = static_cast<size_t>(file_status.st_size);
+
+	// Empty files can not be mapped (and are no valid ROM anyway)
+	if (size_ != 0)
+	{
+		const auto mapping = mmap(nullptr, size_, PROT_READ, MAP_SHARED, file_descriptor, 0);
+		if (mapping == MAP_FAILED)
+		{
+			close(file_descriptor);
+			throw std::runtime_error{ "ROM file could not be mapped" };
+		}
+		data_ = static_cast<const uint8_t*>(mapping);
+	}
+
+	// The mapping does not need the file to stay open
+	close(file_descriptor);
+
+	hash_ = GetFnv1aHash(data_, size_);
+}
+
+RomImage::~RomImage()
+{
+	if (data_ != nullptr) munmap(const_cast<uint8_t*>(data_), size_);
+}
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// Read-only memory mapping of a ROM file, shared by every cartridge of the same file, so that each instance neither copies the ROM nor keeps a copy of its own.
+// Pages are only read from the file as they are first accessed, and the OS keeps a single physical copy of them for all mappings of the file.
+// The file is expected not to change while mapped: a file replaced on disk (different size or write time) is mapped again, but one modified in place is not detected.
+class RomImage final
+{
+public:
+	// Returns the image of the file shared with the other users of the file, if any, or maps it otherwise. Throws if the file can not be opened or mapped.
+	static std::shared_ptr<const RomImage> Open(const std::string &rom_file_path);
+
+	~RomImage();
+
+	RomImage(const RomImage&) = delete;
+	RomImage& operator=(const RomImage&) = delete;
+
+	const uint8_t* GetData() const { return data_; }
+	size_t GetSize() const { return size_; }
+
+	// Computed once when mapped (see Fnv1aHash.h)
+	uint64_t GetHash() const { return hash_; }
+
+private:
+	explicit RomImage(const std::string &rom_file_path);
+
+	const uint8_t *data_{ nullptr };
+	size_t size_{ 0 };
+	uint64_t hash_{ 0 };
+
+#ifdef _WIN32
+	void *file_mapping_handle_{ nullptr };
+#endif
+};
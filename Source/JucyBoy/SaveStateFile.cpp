@@ -0,0 +1,194 @@
+#include "SaveStateFile.h"
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include "Fnv1aHash.h"
+#include "LzCodec.h"
+
+namespace
+{
+	constexpr std::array<char, 4> magic{ 'J', 'B', 'S', 'S' };
+	constexpr uint32_t format_version{ 1 };	// Of the file layout itself (the state layout is JucyBoy::state_version_)
+
+	// In snapshot section order
+	constexpr std::array<std::array<char, 4>, JucyBoy::num_snapshot_sections_> section_tags{ {
+		{ 'C', 'P', 'U', ' ' }, { 'M', 'M', 'U', ' ' }, { 'P', 'P', 'U', ' ' }, { 'A', 'P', 'U', ' ' }, { 'T', 'I', 'M', 'R' }, { 'J', 'O', 'Y', 'P' }, { 'C', 'A', 'R', 'T' } } };
+
+	// Magic, format version, state version, ROM hash and number of sections
+	constexpr size_t header_size{ 4 + 4 + 4 + 8 + 4 };
+	// Tag, size, encoded size and checksum
+	constexpr size_t section_header_size{ 4 + 4 + 4 + 8 };
+
+	// Little endian, regardless of the host
+	void PutLittleEndian(std::vector<uint8_t> &bytes, uint64_t value, size_t num_bytes)
+	{
+		for (size_t i = 0; i < num_bytes; ++i)
+		{
+			bytes.push_back(static_cast<uint8_t>((value >> (8 * i)) & 0xFF));
+		}
+	}
+
+	uint64_t GetLittleEndian(const uint8_t *bytes, size_t num_bytes)
+	{
+		uint64_t value{ 0 };
+		for (size_t i = 0; i < num_bytes; ++i)
+		{
+			value |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+		}
+		return value;
+	}
+
+	void ReadBytes(std::ifstream &file, std::vector<uint8_t> &bytes, size_t num_bytes, const std::string &file_path)
+	{
+		bytes.resize(num_bytes);
+		file.read(reinterpret_cast<char*>(bytes.data()), num_bytes);
+		if (!file) { throw std::runtime_error{ "Save state file is truncated: " + file_path }; }
+	}
+}
+
+void SaveStateFile::Write(const std::string &file_path, const JucyBoy::Snapshot &snapshot, uint64_t rom_hash)
+{
+	// Written aside and then renamed, so that the previous file is kept if writing fails
+	const auto temporary_file_path = file_path + ".tmp";
+	std::ofstream file{ temporary_file_path, std::ios::binary | std::ios::trunc };
+	if (!file) { throw std::runtime_error{ "Could not open save state file: " + temporary_file_path }; }
+
+	std::vector<uint8_t> bytes(magic.begin(), magic.end());
+	PutLittleEndian(bytes, format_version, 4);
+	PutLittleEndian(bytes, JucyBoy::state_version_, 4);
+	PutLittleEndian(bytes, rom_hash, 8);
+	PutLittleEndian(bytes, section_tags.size(), 4);
+
+	LzCodec codec;
+	size_t section_start{ 0 };
+	for (size_t section_index = 0; section_index < section_tags.size(); ++section_index)
+	{
+		const auto *section_data = snapshot.GetData() + section_start;
+		const auto section_size = snapshot.GetSectionEnd(section_index) - section_start;
+
+		// The encoded size is only known once encoded, right after the section header
+		bytes.insert(bytes.end(), section_tags[section_index].begin(), section_tags[section_index].end());
+		PutLittleEndian(bytes, section_size, 4);
+		const auto encoded_size_position = bytes.size();
+		PutLittleEndian(bytes, 0, 4);
+		PutLittleEndian(bytes, GetFnv1aHash(section_data, section_size), 8);
+
+		const auto encoded_data_position = bytes.size();
+		codec.Encode(section_data, section_size, bytes);
+		const auto encoded_size = bytes.size() - encoded_data_position;
+		for (size_t i = 0; i < 4; ++i) bytes[encoded_size_position + i] = static_cast<uint8_t>((encoded_size >> (8 * i)) & 0xFF);
+
+		file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+		if (!file) { throw std::runtime_error{ "Could not write save state file: " + file_path }; }
+
+		bytes.clear();
+		section_start = snapshot.GetSectionEnd(section_index);
+	}
+
+	file.close();
+	if (!file) { throw std::runtime_error{ "Could not write save state file: " + file_path }; }
+
+	std::error_code error_code;
+	std::filesystem::rename(temporary_file_path, file_path, error_code);
+	if (error_code) { throw std::runtime_error{ "Could not write save state file: " + file_path + " (" + error_code.message() + ")" }; }
+}
+
+void SaveStateFile::Read(const std::string &file_path, uint64_t rom_hash, JucyBoy::Snapshot &snapshot)
+{
+	std::ifstream file{ file_path, std::ios::binary };
+	if (!file) { throw std::runtime_error{ "Could not open save state file: " + file_path }; }
+
+	std::vector<uint8_t> bytes;
+	ReadBytes(file, bytes, header_size, file_path);
+	if (!std::equal(magic.begin(), magic.end(), bytes.begin())) { throw std::runtime_error{ "Not a save state file (or one from an older version of JucyBoy): " + file_path }; }
+
+	const auto file_format_version = GetLittleEndian(&bytes[4], 4);
+	const auto file_state_version = GetLittleEndian(&bytes[8], 4);
+	if ((file_format_version != format_version) || (file_state_version != JucyBoy::state_version_))
+	{
+		throw std::runtime_error{ "Unsupported save state version: " + std::to_string(file_format_version) + "." + std::to_string(file_state_version)
+			+ " (supported: " + std::to_string(format_version) + "." + std::to_string(JucyBoy::state_version_) + ")" };
+	}
+	if (GetLittleEndian(&bytes[12], 8) != rom_hash) { throw std::runtime_error{ "Save state of another ROM: " + file_path }; }
+	if (GetLittleEndian(&bytes[20], 4) != section_tags.size()) { throw std::runtime_error{ "Unexpected number of save state sections: " + std::to_string(GetLittleEndian(&bytes[20], 4)) }; }
+
+	std::vector<uint8_t> state;
+	std::vector<uint8_t> encoded_data;
+	for (const auto &section_tag : section_tags)
+	{
+		ReadBytes(file, bytes, section_header_size, file_path);
+		if (!std::equal(section_tag.begin(), section_tag.end(), bytes.begin())) { throw std::runtime_error{ "Unexpected save state section: " + std::string(bytes.begin(), bytes.begin() + 4) }; }
+
+		const auto section_size = static_cast<size_t>(GetLittleEndian(&bytes[4], 4));
+		const auto encoded_size = static_cast<size_t>(GetLittleEndian(&bytes[8], 4));
+		const auto checksum = GetLittleEndian(&bytes[12], 8);
+
+		ReadBytes(file, encoded_data, encoded_size, file_path);
+		const auto section_start = state.size();
+		state.resize(section_start + section_size);
+		LzCodec::Decode(encoded_data.data(), encoded_data.size(), state.data() + section_start, section_size);
+		if (GetFnv1aHash(state.data() + section_start, section_size) != checksum) { throw std::runtime_error{ "Corrupted save state section: " + std::string(section_tag.begin(), section_tag.end()) }; }
+	}
+
+	snapshot.Assign(state.data(), state.size());
+}
+
+SaveStateWriter::SaveStateWriter(ErrorListener &&error_listener) :
+	error_listener_{ std::move(error_listener) }
+{
+	writer_loop_function_result_ = std::async(std::launch::async, &SaveStateWriter::WriterLoopFunction, this);
+}
+
+SaveStateWriter::~SaveStateWriter()
+{
+	{std::lock_guard<std::mutex> lock{ mutex_ };
+	exit_writer_loop_ = true; }
+	writer_condition_.notify_one();
+
+	// Write errors are reported to the listener, so the writer loop does not throw
+	writer_loop_function_result_.wait();
+}
+
+void SaveStateWriter::Write(const std::string &file_path, const JucyBoy::Snapshot &snapshot, uint64_t rom_hash)
+{
+	{std::lock_guard<std::mutex> lock{ mutex_ };
+	pending_writes_.push_back({ file_path, snapshot, rom_hash });
+	++num_writes_in_progress_; }
+	writer_condition_.notify_one();
+}
+
+void SaveStateWriter::WaitForPendingWrites()
+{
+	std::unique_lock<std::mutex> lock{ mutex_ };
+	writes_done_condition_.wait(lock, [this]() { return num_writes_in_progress_ == 0; });
+}
+
+void SaveStateWriter::WriterLoopFunction()
+{
+	std::unique_lock<std::mutex> lock{ mutex_ };
+	for (;;)
+	{
+		// Pending writes are done before exiting
+		writer_condition_.wait(lock, [this]() { return exit_writer_loop_ || !pending_writes_.empty(); });
+		if (pending_writes_.empty()) break;
+
+		auto pending_write = std::move(pending_writes_.front());
+		pending_writes_.pop_front();
+		lock.unlock();
+
+		try
+		{
+			SaveStateFile::Write(pending_write.file_path, pending_write.snapshot, pending_write.rom_hash);
+		}
+		catch (std::exception &e)
+		{
+			if (error_listener_) error_listener_(pending_write.file_path, e.what());
+		}
+
+		lock.lock();
+		--num_writes_in_progress_;
+		writes_done_condition_.notify_all();
+	}
+}
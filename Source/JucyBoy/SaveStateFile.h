@@ -0,0 +1,58 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include "JucyBoy.h"
+
+// Save state files: a header (magic, format and state versions, hash of the ROM), followed by a section per snapshot section (i.e. per component),
+// each one with its sizes and checksum, and LZ compressed (see LzCodec). Sections are compressed and written one at a time.
+// Reading validates the header before anything else, so that the files of other ROMs or versions are rejected right away.
+namespace SaveStateFile
+{
+	void Write(const std::string &file_path, const JucyBoy::Snapshot &snapshot, uint64_t rom_hash);
+
+	// Throws if the file can not be read, or is not a save state of the given ROM (and of the current state version), or is corrupted
+	void Read(const std::string &file_path, uint64_t rom_hash, JucyBoy::Snapshot &snapshot);
+}
+
+// Writes save state files from a thread of its own, so that saving a state only takes capturing its snapshot
+class SaveStateWriter final
+{
+public:
+	// Called from the writer thread when a file could not be written
+	using ErrorListener = std::function<void(const std::string &file_path, const std::string &error)>;
+
+	SaveStateWriter(ErrorListener &&error_listener);
+	~SaveStateWriter();	// Waits for the pending writes
+
+	// Copies the snapshot and returns right away. Files are written in the order requested.
+	void Write(const std::string &file_path, const JucyBoy::Snapshot &snapshot, uint64_t rom_hash);
+
+	// Blocks until all writes requested so far are done (e.g. before reading any of their files)
+	void WaitForPendingWrites();
+
+private:
+	void WriterLoopFunction();
+
+	struct PendingWrite
+	{
+		std::string file_path;
+		JucyBoy::Snapshot snapshot;
+		uint64_t rom_hash;
+	};
+
+	ErrorListener error_listener_;
+
+	std::mutex mutex_;
+	std::condition_variable writer_condition_;	// Notified when there is something to write, or when exiting
+	std::condition_variable writes_done_condition_;
+	std::deque<PendingWrite> pending_writes_;
+	size_t num_writes_in_progress_{ 0 };		// Pending or being written
+	bool exit_writer_loop_{ false };
+	std::future<void> writer_loop_function_result_;
+};
@@ -0,0 +1,91 @@
+#include "Scheduler.h"
+#include <algorithm>
+
+Scheduler::ComponentId Scheduler::AddComponent(SynchronizeFunction &&synchronize_function, NextEventFunction &&next_event_function)
+{
+	components_.emplace_back();
+	components_.back().synchronize = synchronize_function;
+	components_.back().get_machine_cycles_until_next_event = next_event_function;
+	components_.back().synchronized_cycle = current_cycle_;
+
+	UpdateNextEventCycle(components_.back());
+	UpdateNextEventCycle();
+
+	return components_.size() - 1;
+}
+
+void Scheduler::Synchronize(ComponentId component_id)
+{
+	if (synchronizing_) return;
+
+	SynchronizeComponent(components_[component_id]);
+	UpdateNextEventCycle();
+}
+
+void Scheduler::Synchronize()
+{
+	if (synchronizing_) return;
+
+	for (auto &component : components_)
+	{
+		SynchronizeComponent(component);
+	}
+	UpdateNextEventCycle();
+}
+
+void Scheduler::Reschedule(ComponentId component_id)
+{
+	if (synchronizing_) return;
+
+	UpdateNextEventCycle(components_[component_id]);
+	UpdateNextEventCycle();
+}
+
+void Scheduler::SynchronizeDueComponents()
+{
+	if (synchronizing_) return;
+
+	for (auto &component : components_)
+	{
+		if (component.next_event_cycle <= current_cycle_)
+		{
+			SynchronizeComponent(component);
+		}
+	}
+	UpdateNextEventCycle();
+}
+
+void Scheduler::SynchronizeComponent(Component &component)
+{
+	synchronizing_ = true;
+	const auto start_time = profiling_enabled_ ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+
+	const auto num_machine_cycles = static_cast<size_t>(current_cycle_ - component.synchronized_cycle);
+	component.synchronized_cycle = current_cycle_;
+	if (num_machine_cycles > 0)
+	{
+		component.synchronize(num_machine_cycles);
+	}
+
+	UpdateNextEventCycle(component);
+
+	if (profiling_enabled_) { component.synchronization_time += std::chrono::steady_clock::now() - start_time; }
+	synchronizing_ = false;
+}
+
+void Scheduler::UpdateNextEventCycle(Component &component)
+{
+	const auto machine_cycles_until_next_event = std::min<uint64_t>(component.get_machine_cycles_until_next_event(), max_machine_cycles_until_next_event_);
+
+	// An event is never scheduled in the past: the earliest it can be handled is in the next machine cycle
+	component.next_event_cycle = component.synchronized_cycle + std::max<uint64_t>(machine_cycles_until_next_event, 1);
+}
+
+void Scheduler::UpdateNextEventCycle()
+{
+	next_event_cycle_ = std::numeric_limits<uint64_t>::max();
+	for (const auto &component : components_)
+	{
+		next_event_cycle_ = std::min(next_event_cycle_, component.next_event_cycle);
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include <limits>
+#include <chrono>
+
+// Keeps track of the machine cycles lapsed by the CPU, and lets the rest of the components (Timer, PPU, APU) catch up in batches.
+// A component is only synchronized when either:
+//   1) Its next event (e.g. an interrupt request) is due, as reported by the component itself
+//   2) Its memory-mapped registers are about to be accessed by the CPU
+class Scheduler final
+{
+public:
+	using ComponentId = size_t;
+	using SynchronizeFunction = std::function<void(size_t num_machine_cycles)>;
+	using NextEventFunction = std::function<size_t()>;
+
+	static constexpr size_t no_event_{ std::numeric_limits<size_t>::max() };
+
+public:
+	Scheduler() = default;
+	~Scheduler() = default;
+
+	// The synchronize function lapses the given number of machine cycles in the component.
+	// The next event function returns the machine cycles until the component may raise an event that the CPU must observe on time, or no_event_.
+	ComponentId AddComponent(SynchronizeFunction &&synchronize_function, NextEventFunction &&next_event_function);
+
+	// Machine cycle accounting (called by the CPU)
+	inline void OnMachineCycleLapse() { if (++current_cycle_ >= next_event_cycle_) { SynchronizeDueComponents(); } }
+	inline void OnMachineCyclesLapsed(size_t num_machine_cycles) { current_cycle_ += num_machine_cycles; if (current_cycle_ >= next_event_cycle_) { SynchronizeDueComponents(); } }
+	inline size_t GetMachineCyclesUntilNextEvent() const { return (next_event_cycle_ > current_cycle_) ? static_cast<size_t>(next_event_cycle_ - current_cycle_) : 1; }
+	inline uint64_t GetCurrentCycle() const { return current_cycle_; }
+
+	// Catch-up: lapse all pending machine cycles in the component(s) and recompute their next event
+	void Synchronize(ComponentId component_id);
+	void Synchronize();
+
+	// Recompute the next event of a component whose state has been modified externally (e.g. by a register write)
+	void Reschedule(ComponentId component_id);
+
+	// Profiling: accumulate the time spent synchronizing each component (disabled by default, since it reads the clock twice per synchronization)
+	void SetProfilingEnabled(bool enabled) { profiling_enabled_ = enabled; }
+	std::chrono::steady_clock::duration GetSynchronizationTime(ComponentId component_id) const { return components_[component_id].synchronization_time; }
+
+private:
+	struct Component
+	{
+		SynchronizeFunction synchronize;
+		NextEventFunction get_machine_cycles_until_next_event;
+		uint64_t synchronized_cycle{ 0 };
+		uint64_t next_event_cycle{ 0 };
+		std::chrono::steady_clock::duration synchronization_time{ 0 };
+	};
+
+	void SynchronizeDueComponents();
+	void SynchronizeComponent(Component &component);
+	void UpdateNextEventCycle(Component &component);
+	void UpdateNextEventCycle();
+
+private:
+	// Events are never scheduled further than this, to keep the cycle arithmetic far from overflowing
+	static constexpr uint64_t max_machine_cycles_until_next_event_{ uint64_t{ 1 } << 32 };
+
+	std::vector<Component> components_;
+
+	uint64_t current_cycle_{ 0 };
+	uint64_t next_event_cycle_{ 0 };
+
+	// Components may access the memory-mapped registers of other components while being synchronized (e.g. requesting an interrupt via IF).
+	// Those accesses must not trigger a nested synchronization.
+	bool synchronizing_{ false };
+
+	bool profiling_enabled_{ false };
+
+private:
+	Scheduler(const Scheduler&) = delete;
+	Scheduler(Scheduler&&) = delete;
+	Scheduler& operator=(const Scheduler&) = delete;
+	Scheduler& operator=(Scheduler&&) = delete;
+};
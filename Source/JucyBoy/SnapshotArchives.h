@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "cereal/cereal.hpp"
+#include "cereal/types/array.hpp"
+#include "cereal/types/vector.hpp"
+
+// Binary cereal archives over a flat, preallocated buffer, for JucyBoy snapshots.
+// The layout is the same as the one of cereal::BinaryOutputArchive, but data is copied straight into the buffer (rather than through a std::ostream),
+// and arrays of plain values (e.g. the framebuffer, or the decoded tile set) are copied at once rather than element by element.
+class SnapshotOutputArchive final : public cereal::OutputArchive<SnapshotOutputArchive, cereal::AllowEmptyClassElision>
+{
+public:
+	// Writes from the start of the buffer, which only grows (reallocating) if the state does not fit
+	SnapshotOutputArchive(std::vector<uint8_t> &buffer) :
+		cereal::OutputArchive<SnapshotOutputArchive, cereal::AllowEmptyClassElision>(this),
+		buffer_{ buffer }
+	{
+	}
+
+	void SaveBinary(const void *data, size_t size)
+	{
+		const auto end = size_ + size;
+		if (end > buffer_.size()) buffer_.resize(std::max(end, 2 * buffer_.size()));
+		std::memcpy(buffer_.data() + size_, data, size);
+		size_ = end;
+	}
+
+	size_t GetSize() const { return size_; }
+
+private:
+	std::vector<uint8_t> &buffer_;
+	size_t size_{ 0 };
+};
+
+class SnapshotInputArchive final : public cereal::InputArchive<SnapshotInputArchive, cereal::AllowEmptyClassElision>
+{
+public:
+	SnapshotInputArchive(const uint8_t *data, size_t size) :
+		cereal::InputArchive<SnapshotInputArchive, cereal::AllowEmptyClassElision>(this),
+		data_{ data },
+		size_{ size }
+	{
+	}
+
+	void LoadBinary(void *data, size_t size)
+	{
+		if (size > size_ - position_) { throw std::runtime_error{ "Snapshot too short: reading " + std::to_string(size) + " bytes at " + std::to_string(position_) + " of " + std::to_string(size_) }; }
+		std::memcpy(data, data_ + position_, size);
+		position_ += size;
+	}
+
+private:
+	const uint8_t *data_;
+	size_t size_;
+	size_t position_{ 0 };
+};
+
+// Arrays of plain values, possibly nested (but not arrays of classes, which may serialize only part of their members)
+template<class T>
+struct IsSnapshotPlainValue : std::integral_constant<bool, std::is_arithmetic<T>::value || std::is_enum<T>::value> {};
+template<class T, size_t N>
+struct IsSnapshotPlainValue<std::array<T, N>> : IsSnapshotPlainValue<T> {};
+
+template<class T> inline
+typename std::enable_if<std::is_arithmetic<T>::value, void>::type
+CEREAL_SAVE_FUNCTION_NAME(SnapshotOutputArchive &archive, const T &value)
+{
+	archive.SaveBinary(std::addressof(value), sizeof(value));
+}
+
+template<class T> inline
+typename std::enable_if<std::is_arithmetic<T>::value, void>::type
+CEREAL_LOAD_FUNCTION_NAME(SnapshotInputArchive &archive, T &value)
+{
+	archive.LoadBinary(std::addressof(value), sizeof(value));
+}
+
+template<class T, size_t N> inline
+typename std::enable_if<IsSnapshotPlainValue<T>::value && !std::is_arithmetic<T>::value, void>::type
+CEREAL_SAVE_FUNCTION_NAME(SnapshotOutputArchive &archive, const std::array<T, N> &values)
+{
+	archive.SaveBinary(values.data(), sizeof(values));
+}
+
+template<class T, size_t N> inline
+typename std::enable_if<IsSnapshotPlainValue<T>::value && !std::is_arithmetic<T>::value, void>::type
+CEREAL_LOAD_FUNCTION_NAME(SnapshotInputArchive &archive, std::array<T, N> &values)
+{
+	archive.LoadBinary(values.data(), sizeof(values));
+}
+
+template<class T> inline
+void CEREAL_SAVE_FUNCTION_NAME(SnapshotOutputArchive &archive, const cereal::BinaryData<T> &binary_data)
+{
+	archive.SaveBinary(binary_data.data, static_cast<size_t>(binary_data.size));
+}
+
+template<class T> inline
+void CEREAL_LOAD_FUNCTION_NAME(SnapshotInputArchive &archive, cereal::BinaryData<T> &binary_data)
+{
+	archive.LoadBinary(binary_data.data, static_cast<size_t>(binary_data.size));
+}
+
+template<class Archive, class T> inline
+CEREAL_ARCHIVE_RESTRICT(SnapshotInputArchive, SnapshotOutputArchive)
+CEREAL_SERIALIZE_FUNCTION_NAME(Archive &archive, cereal::NameValuePair<T> &name_value_pair)
+{
+	archive(name_value_pair.value);
+}
+
+template<class Archive, class T> inline
+CEREAL_ARCHIVE_RESTRICT(SnapshotInputArchive, SnapshotOutputArchive)
+CEREAL_SERIALIZE_FUNCTION_NAME(Archive &archive, cereal::SizeTag<T> &size_tag)
+{
+	archive(size_tag.size);
+}
+
+CEREAL_REGISTER_ARCHIVE(SnapshotOutputArchive)
+CEREAL_REGISTER_ARCHIVE(SnapshotInputArchive)
+
+CEREAL_SETUP_ARCHIVE_TRAITS(SnapshotInputArchive, SnapshotOutputArchive)
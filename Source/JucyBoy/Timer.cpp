@@ -1,5 +1,7 @@
 #include "Timer.h"
 #include "MMU.h"
+#include "Scheduler.h"
+#include <algorithm>
 #include <string>
 
 Timer::Timer(MMU &mmu) :
@@ -33,6 +35,37 @@ void Timer::OnMachineCycleLapse()
 	}
 }
 
+void Timer::OnMachineCyclesLapsed(size_t num_machine_cycles)
+{
+	while (num_machine_cycles > 0)
+	{
+		// The cycles right after an overflow are lapsed one by one, since TIMA/TMA writes behave differently during them
+		if (timer_overflow_state_ != TimerOverflowState::NoOverflow)
+		{
+			OnMachineCycleLapse();
+			--num_machine_cycles;
+			continue;
+		}
+
+		// Otherwise, lapse at once all the cycles up to the next overflow (included)
+		const auto num_machine_cycles_to_lapse = std::min(num_machine_cycles, GetMachineCyclesUntilNextEvent());
+		LapseMachineCycles(num_machine_cycles_to_lapse);
+		num_machine_cycles -= num_machine_cycles_to_lapse;
+	}
+}
+
+size_t Timer::GetMachineCyclesUntilNextEvent() const
+{
+	// TIMA reload must be processed on time, since TIMA/TMA writes behave differently during these cycles
+	if (timer_overflow_state_ != TimerOverflowState::NoOverflow) return 1;
+
+	if (!timer_enabled_) return Scheduler::no_event_;
+
+	// Machine cycles until the next TIMA increase, plus the ones for the remaining increases until TIMA overflows (requesting the Timer interrupt)
+	const auto clock_cycles_until_next_increase = timer_period_ - (internal_counter_ & (timer_period_ - 1));
+	return (clock_cycles_until_next_increase + (0xFF - timer_counter_) * timer_period_) / 4;
+}
+
 // MMU mapped memory read/write functions
 uint8_t Timer::OnIoMemoryRead(Memory::Address address) const
 {
@@ -126,6 +159,23 @@ void Timer::OnIoMemoryWritten(Memory::Address address, uint8_t value)
 	}
 }
 
+void Timer::LapseMachineCycles(size_t num_machine_cycles)
+{
+	const auto previous_internal_counter = uint64_t{ internal_counter_ };
+	const auto internal_counter = previous_internal_counter + 4 * uint64_t{ num_machine_cycles };
+	internal_counter_ = static_cast<uint16_t>(internal_counter);
+
+	if (!timer_enabled_) return;
+
+	// TIMA increases every time the internal counter reaches a multiple of the timer period (which divides its 16-bit range, so wrapping around does not matter).
+	// There are never more increases than those left until TIMA overflows, and the last one goes through IncreaseTimer in order to detect the overflow.
+	const auto num_increases = (internal_counter / timer_period_) - (previous_internal_counter / timer_period_);
+	if (num_increases == 0) return;
+
+	timer_counter_ += static_cast<uint8_t>(num_increases - 1);
+	IncreaseTimer();
+}
+
 void Timer::IncreaseTimer()
 {
 	if (++timer_counter_ == 0)
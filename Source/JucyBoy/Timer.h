@@ -12,8 +12,10 @@ public:
 	Timer(MMU &mmu);
 	~Timer() = default;
 
-	// CPU::Listener overrides
+	// Scheduler functions
 	void OnMachineCycleLapse();
+	void OnMachineCyclesLapsed(size_t num_machine_cycles);
+	size_t GetMachineCyclesUntilNextEvent() const;
 
 	// MMU mapped memory read/write functions
 	uint8_t OnIoMemoryRead(Memory::Address address) const;
@@ -23,6 +25,7 @@ public:
 	void serialize(Archive &archive);
 
 private:
+	void LapseMachineCycles(size_t num_machine_cycles); // No overflow state must be pending, and no further than the next overflow
 	void IncreaseTimer();
 
 private:
@@ -1,10 +1,7 @@
 #include "JucyBoyComponent.h"
 #include "JucyBoy/JucyBoy.h"
-#include <fstream>
 #include <cassert>
-#include "cereal/archives/binary.hpp"
-#include "cereal/types/array.hpp"
-#include "cereal/types/vector.hpp"
+#include <algorithm>
 
 JucyBoyComponent::JucyBoyComponent()
 {
@@ -54,6 +51,8 @@ void JucyBoyComponent::LoadRom(std::string file_path)
 	}
 
 	jucy_boy_.reset();
+	rewind_buffer_.Clear();
+	num_frames_since_rewind_capture_ = 0;
 
 	try
 	{
@@ -61,8 +60,13 @@ void JucyBoyComponent::LoadRom(std::string file_path)
 
 		// Set listener interfaces
 		listener_deregister_functions_.emplace_back(jucy_boy_->GetCpu().AddRunningLoopInterruptionListener([this]() { OnRunningLoopInterrupted(); }));
-		listener_deregister_functions_.emplace_back(jucy_boy_->GetPpu().AddNewFrameListener([this]() { game_screen_component_.UpdateFramebuffer(); }));
-		listener_deregister_functions_.emplace_back(jucy_boy_->GetApu().AddListener([this](APU::SampleBatch &sample_batch) { audio_player_component_.OnNewSamples(sample_batch); }));
+		listener_deregister_functions_.emplace_back(jucy_boy_->AddFramePresentationListener([this]() { OnNewFrame(); }));
+		listener_deregister_functions_.emplace_back(jucy_boy_->GetApu().AddOutputListener([this](const APU::OutputSample *output_samples, size_t num_output_samples) { OnNewSamples(output_samples, num_output_samples); }));
+		listener_deregister_functions_.emplace_back(jucy_boy_->AddFrameSafePointListener([this]() { OnFrameSafePoint(); }));
+
+		// The audio device does not pace the emulation (it never blocks it), so it has to pace itself
+		ApplyEmulationSpeed();
+		jucy_boy_->SetRunAheadFrames(num_run_ahead_frames_);
 
 		// Set references to JucyBoy components
 		game_screen_component_.SetPpu(&jucy_boy_->GetPpu());
@@ -118,10 +122,8 @@ void JucyBoyComponent::resized()
 	game_screen_component_.setBounds(getLocalBounds());
 }
 
-void JucyBoyComponent::SaveState() const
+std::string JucyBoyComponent::GetSaveStateFilePath() const
 {
-	if (loaded_rom_file_path_.empty()) return;
-
 	auto save_state_file_path = loaded_rom_file_path_;
 	const auto extension = ".jb" + std::to_string(selected_save_slot_);
 
@@ -134,44 +136,112 @@ void JucyBoyComponent::SaveState() const
 	{
 		save_state_file_path.append(extension);
 	}
+	return save_state_file_path;
+}
 
-	std::ofstream save_state_file{ save_state_file_path, std::ios::binary };
-
-	{cereal::BinaryOutputArchive  output_archive{ save_state_file };
-	output_archive(*jucy_boy_); }
+// Only the snapshot is taken here: the file is compressed and written by the save state writer thread
+void JucyBoyComponent::SaveState()
+{
+	if (loaded_rom_file_path_.empty()) return;
 
-	save_state_file.close();
+	jucy_boy_->SaveSnapshot(save_state_snapshot_);
+	save_state_writer_.Write(GetSaveStateFilePath(), save_state_snapshot_, jucy_boy_->GetRomHash());
 }
 
 void JucyBoyComponent::LoadState()
 {
 	if (loaded_rom_file_path_.empty()) return;
 
-	auto save_state_file_path = loaded_rom_file_path_;
-	const auto extension = ".jb" + std::to_string(selected_save_slot_);
+	// The state may have just been saved
+	save_state_writer_.WaitForPendingWrites();
 
-	const auto last_dot_position = save_state_file_path.find_last_of('.');
-	if (std::string::npos != last_dot_position)
+	const auto save_state_file_path = GetSaveStateFilePath();
+	if (!juce::File{ save_state_file_path }.existsAsFile()) return;
+
+	try
 	{
-		save_state_file_path.replace(last_dot_position, std::string::npos, extension);
+		SaveStateFile::Read(save_state_file_path, jucy_boy_->GetRomHash(), save_state_snapshot_);
 	}
-	else
+	catch (std::exception &e)
 	{
-		save_state_file_path.append(extension);
+		juce::AlertWindow::showMessageBox(juce::AlertWindow::AlertIconType::WarningIcon, "Failed to load state", juce::String{ "Error: " } + e.what());
+		return;
 	}
 
-	std::ifstream save_state_file{ save_state_file_path, std::ios::binary | std::ios::ate };
-	if (!save_state_file.is_open()) return;
+	jucy_boy_->LoadSnapshot(save_state_snapshot_);
+	audio_player_component_.ClearBuffer();
+	game_screen_component_.UpdateFramebuffer();
+}
+
+void JucyBoyComponent::ApplyEmulationSpeed()
+{
+	if (jucy_boy_) jucy_boy_->SetEmulationSpeed(fast_forward_enabled_ ? fast_forward_speeds_[selected_fast_forward_speed_] : 1.0);
+}
 
-	const auto file_size = static_cast<size_t>(save_state_file.tellg());
-	if (file_size > 0)
+// Called from the emulation thread
+void JucyBoyComponent::OnNewFrame()
+{
+	if (jucy_boy_->GetEmulationSpeed() != 1.0)
 	{
-		save_state_file.seekg(0, std::ios::beg);
-		cereal::BinaryInputArchive  input_archive{ save_state_file };
-		input_archive(*jucy_boy_);
+		const auto now = std::chrono::steady_clock::now();
+		if (now - last_frame_presentation_time_ < min_frame_presentation_period_) return;
+		last_frame_presentation_time_ = now;
 	}
 
-	save_state_file.close();
+	game_screen_component_.UpdateFramebuffer();
+}
+
+// Called from the emulation thread
+void JucyBoyComponent::OnNewSamples(const APU::OutputSample *output_samples, size_t num_output_samples)
+{
+	audio_player_component_.OnNewSamples(output_samples, num_output_samples);
+
+	// When not running at real-time speed, the audio is decimated (resampled to a proportionally lower rate, so it plays faster)
+	// so that it is consumed as fast as it is produced, instead of overflowing the buffer
+	auto speed = jucy_boy_->GetEmulationSpeed();
+	if (speed == JucyBoy::uncapped_speed_) speed = std::max(jucy_boy_->GetMeasuredSpeed(), 1.0);
+
+	if (const auto output_sample_rate = audio_player_component_.GetAdjustedOutputSampleRate())
+	{
+		jucy_boy_->GetApu().SetOutputSampleRate(std::max(static_cast<size_t>(output_sample_rate / speed), size_t{ 1 }));
+	}
+}
+
+// Called from the emulation thread
+void JucyBoyComponent::OnFrameSafePoint()
+{
+	if (++num_frames_since_rewind_capture_ < rewind_capture_period_) return;
+	num_frames_since_rewind_capture_ = 0;
+
+	if (rewind_buffer_.GetMemoryBudget() == 0)
+	{
+		rewind_buffer_.Clear();
+		return;
+	}
+
+	jucy_boy_->SaveSnapshot(rewind_snapshot_);
+	rewind_buffer_.Push(rewind_snapshot_);
+}
+
+// Only while the emulation is paused, since the rewind buffer is filled from the emulation thread
+void JucyBoyComponent::Rewind()
+{
+	if (!jucy_boy_ || jucy_boy_->IsRunning()) return;
+
+	const auto num_frames_back = static_cast<size_t>(std::chrono::seconds{ rewind_seconds_[selected_rewind_seconds_] } / min_frame_presentation_period_);
+	if (!rewind_buffer_.Rewind(num_frames_back / rewind_capture_period_, rewind_snapshot_)) return;
+
+	jucy_boy_->LoadSnapshot(rewind_snapshot_);
+	num_frames_since_rewind_capture_ = 0;
+
+	audio_player_component_.ClearBuffer();
+	game_screen_component_.UpdateFramebuffer();
+}
+
+void JucyBoyComponent::SetRunAheadFrames(size_t num_frames)
+{
+	num_run_ahead_frames_ = num_frames;
+	if (jucy_boy_) jucy_boy_->SetRunAheadFrames(num_run_ahead_frames_);
 }
 
 void JucyBoyComponent::mouseDown(const juce::MouseEvent &event)
@@ -193,6 +263,20 @@ void JucyBoyComponent::mouseDown(const juce::MouseEvent &event)
 		save_slot_submenu.addCommandItem(&application_command_manager_, select_slot_command_id);
 	}
 
+	juce::PopupMenu fast_forward_speed_submenu;
+	fast_forward_speed_submenu.setLookAndFeel(&look_and_feel_);
+	for (int select_speed_command_id = CommandIDs::SelectFastForwardSpeed1Cmd; select_speed_command_id <= CommandIDs::SelectFastForwardSpeed5Cmd; ++select_speed_command_id)
+	{
+		fast_forward_speed_submenu.addCommandItem(&application_command_manager_, select_speed_command_id);
+	}
+
+	juce::PopupMenu rewind_seconds_submenu;
+	rewind_seconds_submenu.setLookAndFeel(&look_and_feel_);
+	for (int select_seconds_command_id = CommandIDs::SelectRewindSeconds1Cmd; select_seconds_command_id <= CommandIDs::SelectRewindSeconds4Cmd; ++select_seconds_command_id)
+	{
+		rewind_seconds_submenu.addCommandItem(&application_command_manager_, select_seconds_command_id);
+	}
+
 	juce::PopupMenu menu;
 	menu.setLookAndFeel(&look_and_feel_);
 	menu.addCommandItem(&application_command_manager_, CommandIDs::LoadRomFileCmd);
@@ -202,6 +286,11 @@ void JucyBoyComponent::mouseDown(const juce::MouseEvent &event)
 	menu.addCommandItem(&application_command_manager_, CommandIDs::LoadStateCmd);
 	menu.addSubMenu("Select save slot", save_slot_submenu);
 	menu.addSeparator();
+	menu.addCommandItem(&application_command_manager_, CommandIDs::ToggleFastForwardCmd);
+	menu.addSubMenu("Fast-forward speed", fast_forward_speed_submenu);
+	menu.addCommandItem(&application_command_manager_, CommandIDs::RewindCmd);
+	menu.addSubMenu("Rewind by", rewind_seconds_submenu);
+	menu.addSeparator();
 	menu.addCommandItem(&application_command_manager_, CommandIDs::ShowCpuDebuggingCmd);
 	menu.addCommandItem(&application_command_manager_, CommandIDs::ShowPpuDebuggingCmd);
 	menu.addSeparator();
@@ -354,6 +443,33 @@ void JucyBoyComponent::getCommandInfo(juce::CommandID commandID, juce::Applicati
 		result.setTicked(selected_save_slot_ == (1 + (commandID - CommandIDs::SelectSaveSlot1Cmd)));
 		result.addDefaultKeypress('1' + (commandID - CommandIDs::SelectSaveSlot1Cmd), juce::ModifierKeys::commandModifier);
 		break;
+	case CommandIDs::ToggleFastForwardCmd:
+		result.setInfo("Fast-forward", "Run faster than the real hardware", "Speed", 0);
+		result.setTicked(fast_forward_enabled_);
+		result.addDefaultKeypress('f', juce::ModifierKeys::commandModifier);
+		break;
+	case CommandIDs::SelectFastForwardSpeed1Cmd:
+	case CommandIDs::SelectFastForwardSpeed2Cmd:
+	case CommandIDs::SelectFastForwardSpeed3Cmd:
+	case CommandIDs::SelectFastForwardSpeed4Cmd:
+	case CommandIDs::SelectFastForwardSpeed5Cmd:
+		{const auto speed = fast_forward_speeds_[commandID - CommandIDs::SelectFastForwardSpeed1Cmd];
+		result.setInfo((speed == 0.0) ? std::string{ "Uncapped" } : std::to_string(static_cast<int>(speed)) + "x", "Select fast-forward speed", "Speed", 0);
+		result.setTicked(selected_fast_forward_speed_ == static_cast<size_t>(commandID - CommandIDs::SelectFastForwardSpeed1Cmd)); }
+		break;
+	case CommandIDs::RewindCmd:
+		result.setInfo("Rewind", "Go back in time by the selected number of seconds", "Rewind", 0);
+		result.setActive(static_cast<bool>(jucy_boy_) && (rewind_buffer_.GetMemoryBudget() != 0));
+		result.addDefaultKeypress(juce::KeyPress::backspaceKey, juce::ModifierKeys::noModifiers);
+		break;
+	case CommandIDs::SelectRewindSeconds1Cmd:
+	case CommandIDs::SelectRewindSeconds2Cmd:
+	case CommandIDs::SelectRewindSeconds3Cmd:
+	case CommandIDs::SelectRewindSeconds4Cmd:
+		{const auto seconds = rewind_seconds_[commandID - CommandIDs::SelectRewindSeconds1Cmd];
+		result.setInfo(std::to_string(seconds) + ((seconds == 1) ? " second" : " seconds"), "Select how far back to rewind", "Rewind", 0);
+		result.setTicked(selected_rewind_seconds_ == static_cast<size_t>(commandID - CommandIDs::SelectRewindSeconds1Cmd)); }
+		break;
 	case CommandIDs::ShowCpuDebuggingCmd:
 		result.setInfo("Debug CPU...", "Show CPU + memory debugging window", "General", 0);
 		result.setTicked(cpu_debug_component_.isVisible());
@@ -413,6 +529,27 @@ bool JucyBoyComponent::perform(const InvocationInfo& info)
 	case CommandIDs::SelectSaveSlot8Cmd:
 		SelectSaveSlot(1 + (info.commandID - CommandIDs::SelectSaveSlot1Cmd));
 		break;
+	case CommandIDs::ToggleFastForwardCmd:
+		fast_forward_enabled_ = !fast_forward_enabled_;
+		ApplyEmulationSpeed();
+		break;
+	case CommandIDs::SelectFastForwardSpeed1Cmd:
+	case CommandIDs::SelectFastForwardSpeed2Cmd:
+	case CommandIDs::SelectFastForwardSpeed3Cmd:
+	case CommandIDs::SelectFastForwardSpeed4Cmd:
+	case CommandIDs::SelectFastForwardSpeed5Cmd:
+		selected_fast_forward_speed_ = info.commandID - CommandIDs::SelectFastForwardSpeed1Cmd;
+		ApplyEmulationSpeed();
+		break;
+	case CommandIDs::RewindCmd:
+		Rewind();
+		break;
+	case CommandIDs::SelectRewindSeconds1Cmd:
+	case CommandIDs::SelectRewindSeconds2Cmd:
+	case CommandIDs::SelectRewindSeconds3Cmd:
+	case CommandIDs::SelectRewindSeconds4Cmd:
+		selected_rewind_seconds_ = info.commandID - CommandIDs::SelectRewindSeconds1Cmd;
+		break;
 	case CommandIDs::ShowCpuDebuggingCmd:
 		if (!cpu_debug_component_.isVisible())
 		{
@@ -4,9 +4,13 @@
 #include <functional>
 #include <vector>
 #include <memory>
+#include <array>
+#include <chrono>
 #include "GameScreenComponent.h"
 #include "AudioPlayerComponent.h"
 #include "JucyBoy/CPU.h"
+#include "JucyBoy/RewindBuffer.h"
+#include "JucyBoy/SaveStateFile.h"
 #include "OptionsComponents/OptionsComponent.h"
 #include "DebugComponents/CpuDebugComponent.h"
 #include "DebugComponents/PpuDebugComponent.h"
@@ -36,10 +40,23 @@ private:
 	void PauseEmulation();
 
 	// Save/load state
-	void SaveState() const;
+	std::string GetSaveStateFilePath() const;
+	void SaveState();
 	void LoadState();
 	void SelectSaveSlot(size_t selected_save_slot) { selected_save_slot_ = selected_save_slot; }
 
+	// Fast-forward
+	void ApplyEmulationSpeed();
+	void OnNewFrame();
+	void OnNewSamples(const APU::OutputSample *output_samples, size_t num_output_samples);
+
+	// Rewind
+	void OnFrameSafePoint();
+	void Rewind();
+
+	// Run-ahead
+	void SetRunAheadFrames(size_t num_frames);
+
 	// juce::ApplicationCommandTarget overrides
 	ApplicationCommandTarget* getNextCommandTarget() override;
 	void getAllCommands(juce::Array<juce::CommandID>& commands) override;
@@ -58,7 +75,22 @@ private:
 	GameScreenComponent game_screen_component_;
 	AudioPlayerComponent audio_player_component_;
 
-	OptionsComponent options_component_{ game_screen_component_, audio_player_component_ };
+	// A snapshot is captured every few frames (and once the memory budget is used up, the oldest ones are dropped). About 32 MB keep a minute and a half.
+	static constexpr size_t rewind_capture_period_{ 4 };
+	static constexpr size_t rewind_keyframe_interval_{ 60 };
+	static constexpr size_t default_rewind_memory_budget_{ 32 << 20 };
+	RewindBuffer rewind_buffer_{ default_rewind_memory_budget_, rewind_keyframe_interval_ };
+	JucyBoy::Snapshot rewind_snapshot_;
+	size_t num_frames_since_rewind_capture_{ 0 };
+
+	// Seconds to rewind by that can be selected
+	static constexpr std::array<int, 4> rewind_seconds_{ 1, 5, 10, 30 };
+	size_t selected_rewind_seconds_{ 1 };
+
+	// Frames emulated ahead of each frame presented (see JucyBoy::SetRunAheadFrames), kept across ROM loads
+	size_t num_run_ahead_frames_{ 0 };
+
+	OptionsComponent options_component_{ game_screen_component_, audio_player_component_, rewind_buffer_, [this](size_t num_frames) { SetRunAheadFrames(num_frames); } };
 	AdditionalWindow options_window_{ options_component_, "JucyBoy Options", juce::Colours::white, juce::DocumentWindow::closeButton };
 	CpuDebugComponent cpu_debug_component_;
 	AdditionalWindow cpu_debug_window_{ cpu_debug_component_, "JucyBoy CPU Debugger", juce::Colours::white, juce::DocumentWindow::closeButton };
@@ -66,6 +98,22 @@ private:
 	AdditionalWindow ppu_debug_window_{ ppu_debug_component_, "JucyBoy PPU Debugger", juce::Colours::white, juce::DocumentWindow::closeButton };
 
 	size_t selected_save_slot_{ 1 }; // Slot 0 is not used
+	JucyBoy::Snapshot save_state_snapshot_;
+
+	// Errors are reported from the writer thread, so they are shown from the message thread
+	SaveStateWriter save_state_writer_{ [](const std::string &file_path, const std::string &error)
+	{
+		juce::MessageManager::callAsync([file_path, error]() { juce::AlertWindow::showMessageBox(juce::AlertWindow::WarningIcon, "Failed to save state", juce::String{ "Error: " + error + " (" + file_path + ")" }); });
+	} };
+
+	// Fast-forward speeds that can be selected, the last one uncapped (see JucyBoy::SetEmulationSpeed). The emulation runs at real-time speed otherwise.
+	static constexpr std::array<double, 5> fast_forward_speeds_{ 2.0, 3.0, 4.0, 8.0, 0.0 };
+	bool fast_forward_enabled_{ false };
+	size_t selected_fast_forward_speed_{ 0 };
+
+	// While fast-forwarding, frames are presented at most at the rate of the real hardware, and the rest are skipped
+	static constexpr std::chrono::nanoseconds min_frame_presentation_period_{ 16742706 }; // One frame: 70224 clock cycles at 4.194304 MHz
+	std::chrono::steady_clock::time_point last_frame_presentation_time_;
 
 	juce::ApplicationCommandManager application_command_manager_;
 	// The command IDs have to be consecutive, due to the method used to feed them to the manager in getAllCommands
@@ -83,6 +131,17 @@ private:
 		SelectSaveSlot6Cmd,
 		SelectSaveSlot7Cmd,
 		SelectSaveSlot8Cmd,
+		ToggleFastForwardCmd,
+		SelectFastForwardSpeed1Cmd,
+		SelectFastForwardSpeed2Cmd,
+		SelectFastForwardSpeed3Cmd,
+		SelectFastForwardSpeed4Cmd,
+		SelectFastForwardSpeed5Cmd,
+		RewindCmd,
+		SelectRewindSeconds1Cmd,
+		SelectRewindSeconds2Cmd,
+		SelectRewindSeconds3Cmd,
+		SelectRewindSeconds4Cmd,
 		ShowCpuDebuggingCmd,
 		ShowPpuDebuggingCmd,
 		ViewOptionsCmd,
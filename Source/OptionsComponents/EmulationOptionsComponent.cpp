@@ -0,0 +1,60 @@
+#include "EmulationOptionsComponent.h"
+#include "../JucyBoy/RewindBuffer.h"
+
+namespace
+{
+	constexpr size_t bytes_per_megabyte{ 1 << 20 };
+}
+
+EmulationOptionsComponent::EmulationOptionsComponent(RewindBuffer &rewind_buffer, RunAheadFramesSetter &&set_run_ahead_frames) :
+	rewind_buffer_{ &rewind_buffer },
+	set_run_ahead_frames_{ std::move(set_run_ahead_frames) }
+{
+	addAndMakeVisible(rewind_memory_label_);
+	addAndMakeVisible(rewind_memory_slider_);
+	addAndMakeVisible(run_ahead_frames_label_);
+	addAndMakeVisible(run_ahead_frames_slider_);
+
+	rewind_memory_label_.setText("Rewind memory (0 disables rewind)", juce::NotificationType::dontSendNotification);
+	rewind_memory_label_.attachToComponent(&rewind_memory_slider_, false);
+
+	rewind_memory_slider_.setRange(0.0, 256.0, 1.0);
+	rewind_memory_slider_.setTextValueSuffix(" MB");
+	rewind_memory_slider_.setValue(static_cast<double>(rewind_buffer_->GetMemoryBudget() / bytes_per_megabyte), juce::NotificationType::dontSendNotification);
+
+	// Each frame run ahead hides a frame of input lag, but it takes as long to emulate as the frame itself
+	run_ahead_frames_label_.setText("Run-ahead frames (0 disables run-ahead)", juce::NotificationType::dontSendNotification);
+	run_ahead_frames_label_.attachToComponent(&run_ahead_frames_slider_, false);
+
+	run_ahead_frames_slider_.setRange(0.0, 4.0, 1.0);
+	run_ahead_frames_slider_.setValue(0.0, juce::NotificationType::dontSendNotification);
+
+	rewind_memory_slider_.addListener(this);
+	run_ahead_frames_slider_.addListener(this);
+}
+
+void EmulationOptionsComponent::sliderValueChanged(juce::Slider* slider)
+{
+	if (slider == &rewind_memory_slider_)
+	{
+		rewind_buffer_->SetMemoryBudget(static_cast<size_t>(rewind_memory_slider_.getValue()) * bytes_per_megabyte);
+	}
+	else if (slider == &run_ahead_frames_slider_)
+	{
+		set_run_ahead_frames_(static_cast<size_t>(run_ahead_frames_slider_.getValue()));
+	}
+}
+
+void EmulationOptionsComponent::paint(juce::Graphics& g)
+{
+	g.fillAll(juce::Colours::white);
+}
+
+void EmulationOptionsComponent::resized()
+{
+	// Each slider takes the bottom half of its row, leaving room for its attached label
+	auto working_area = getLocalBounds();
+	auto top_half = working_area.removeFromTop(working_area.getHeight() / 2);
+	rewind_memory_slider_.setBounds(top_half.removeFromBottom(top_half.getHeight() / 2));
+	run_ahead_frames_slider_.setBounds(working_area.removeFromBottom(working_area.getHeight() / 2));
+}
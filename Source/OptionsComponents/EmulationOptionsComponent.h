@@ -0,0 +1,32 @@
+#pragma once
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+#include <functional>
+
+class RewindBuffer;
+
+class EmulationOptionsComponent : public juce::Component, public juce::Slider::Listener
+{
+public:
+	// Run-ahead is set through a function, since it is applied to every JucyBoy loaded
+	using RunAheadFramesSetter = std::function<void(size_t num_frames)>;
+	EmulationOptionsComponent(RewindBuffer &rewind_buffer, RunAheadFramesSetter &&set_run_ahead_frames);
+	~EmulationOptionsComponent() = default;
+
+	void sliderValueChanged(juce::Slider* slider) override;
+
+	void paint(juce::Graphics&) override;
+	void resized() override;
+
+private:
+	juce::Label rewind_memory_label_;
+	juce::Slider rewind_memory_slider_;
+	juce::Label run_ahead_frames_label_;
+	juce::Slider run_ahead_frames_slider_;
+
+	RewindBuffer* rewind_buffer_;
+	RunAheadFramesSetter set_run_ahead_frames_;
+
+private:
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EmulationOptionsComponent)
+};
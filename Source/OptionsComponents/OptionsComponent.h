@@ -3,20 +3,24 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "GraphicOptionsComponent.h"
 #include "AudioOptionsComponent.h"
+#include "EmulationOptionsComponent.h"
 
 class OptionsComponent : public juce::Component
 {
 public:
-	OptionsComponent(GameScreenComponent &game_screen_component, AudioPlayerComponent &audio_player_component) :
+	OptionsComponent(GameScreenComponent &game_screen_component, AudioPlayerComponent &audio_player_component, RewindBuffer &rewind_buffer,
+		EmulationOptionsComponent::RunAheadFramesSetter &&set_run_ahead_frames) :
 		graphic_options_{ game_screen_component },
-		audio_options_{ audio_player_component }
+		audio_options_{ audio_player_component },
+		emulation_options_{ rewind_buffer, std::move(set_run_ahead_frames) }
 	{
 		addAndMakeVisible(tabbed_component_);
 
 		tabbed_component_.addTab("Graphics", juce::Colours::white, &graphic_options_, true);
 		tabbed_component_.addTab("Audio", juce::Colours::white, &audio_options_, true);
+		tabbed_component_.addTab("Emulation", juce::Colours::white, &emulation_options_, true);
 
-		setSize(300, 100);
+		setSize(300, 160);
 	}
 	~OptionsComponent() = default;
 
@@ -30,6 +34,7 @@ private:
 	juce::TabbedComponent tabbed_component_{ juce::TabbedButtonBar::TabsAtTop };
 	GraphicOptionsComponent graphic_options_;
 	AudioOptionsComponent audio_options_;
+	EmulationOptionsComponent emulation_options_;
 
 private:
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OptionsComponent)
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Lock-free ring buffer for a single producer thread and a single consumer thread (e.g. the emulation thread and the audio device thread).
+// Neither side ever blocks: writes that do not fit are truncated, and so are reads of more elements than available.
+// JUCE-free, so that it can also be used (and benchmarked) without the GUI.
+template<class T>
+class SpscRingBuffer final
+{
+public:
+	SpscRingBuffer() = default;
+	~SpscRingBuffer() = default;
+
+	// Not thread-safe: must be called while neither the producer nor the consumer is using the buffer. The capacity is rounded up to a power of 2.
+	void SetCapacity(size_t capacity);
+	size_t GetCapacity() const { return elements_.size(); }
+
+	// Producer side: returns the number of elements written
+	size_t Write(const T *elements, size_t num_elements);
+	size_t GetFreeSpace() const { return elements_.size() - GetNumReadable(); }
+
+	// Consumer side: returns the number of elements read
+	size_t Read(T *elements, size_t num_elements);
+	size_t Discard(size_t num_elements);
+	size_t GetNumReadable() const { return write_index_.load(std::memory_order_acquire) - read_index_.load(std::memory_order_acquire); }
+
+private:
+	// Indices increase monotonically (wrapping around size_t), and are masked on access
+	std::vector<T> elements_;
+	size_t index_mask_{ 0 };
+	std::atomic<size_t> write_index_{ 0 };
+	std::atomic<size_t> read_index_{ 0 };
+
+private:
+	SpscRingBuffer(const SpscRingBuffer&) = delete;
+	SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+};
+
+template<class T>
+void SpscRingBuffer<T>::SetCapacity(size_t capacity)
+{
+	if (capacity == 0) { throw std::invalid_argument{ "Invalid ring buffer capacity: " + std::to_string(capacity) }; }
+
+	size_t power_of_2_capacity{ 1 };
+	while (power_of_2_capacity < capacity) { power_of_2_capacity <<= 1; }
+
+	elements_.assign(power_of_2_capacity, T{});
+	index_mask_ = power_of_2_capacity - 1;
+	write_index_.store(0);
+	read_index_.store(0);
+}
+
+template<class T>
+size_t SpscRingBuffer<T>::Write(const T *elements, size_t num_elements)
+{
+	const auto write_index = write_index_.load(std::memory_order_relaxed);
+	const auto num_free_elements = elements_.size() - (write_index - read_index_.load(std::memory_order_acquire));
+	if (num_elements > num_free_elements) num_elements = num_free_elements;
+
+	for (size_t i = 0; i < num_elements; ++i)
+	{
+		elements_[(write_index + i) & index_mask_] = elements[i];
+	}
+
+	write_index_.store(write_index + num_elements, std::memory_order_release);
+	return num_elements;
+}
+
+template<class T>
+size_t SpscRingBuffer<T>::Read(T *elements, size_t num_elements)
+{
+	const auto read_index = read_index_.load(std::memory_order_relaxed);
+	const auto num_readable_elements = write_index_.load(std::memory_order_acquire) - read_index;
+	if (num_elements > num_readable_elements) num_elements = num_readable_elements;
+
+	for (size_t i = 0; i < num_elements; ++i)
+	{
+		elements[i] = elements_[(read_index + i) & index_mask_];
+	}
+
+	read_index_.store(read_index + num_elements, std::memory_order_release);
+	return num_elements;
+}
+
+template<class T>
+size_t SpscRingBuffer<T>::Discard(size_t num_elements)
+{
+	const auto read_index = read_index_.load(std::memory_order_relaxed);
+	const auto num_readable_elements = write_index_.load(std::memory_order_acquire) - read_index;
+	if (num_elements > num_readable_elements) num_elements = num_readable_elements;
+
+	read_index_.store(read_index + num_elements, std::memory_order_release);
+	return num_elements;
+}
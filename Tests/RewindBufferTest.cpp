@@ -0,0 +1,115 @@
+// Rewind buffer test: snapshots restored from a rewind buffer must be bit-identical to the ones pushed into it.
+//
+// Snapshots are taken from a frame safe point listener every couple of frames, pushed into a rewind buffer, and kept aside as well.
+// The buffer is then rewound step by step, and every restored snapshot is compared with the one kept aside.
+// The same snapshots are then pushed into a buffer with a small memory budget, which must drop the oldest ones but restore the rest just the same.
+// Runs the bundled game loop ROM (see BenchmarkCommon.h) plus any ROM files given in the command line.
+//
+// Usage: RewindBufferTest [rom files...]
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "JucyBoy/JucyBoy.h"
+#include "JucyBoy/RewindBuffer.h"
+#include "../Benchmarks/BenchmarkCommon.h"
+
+namespace
+{
+	constexpr size_t num_frames{ 600 };
+	constexpr size_t capture_period{ 2 };
+	constexpr size_t keyframe_interval{ 30 };
+
+	using SnapshotData = std::vector<uint8_t>;
+
+	SnapshotData GetSnapshotData(const JucyBoy::Snapshot &snapshot) { return{ snapshot.GetData(), snapshot.GetData() + snapshot.GetSize() }; }
+
+	// Rewinds step by step (with increasing steps), checking each restored snapshot against the history. Returns an empty string on success.
+	std::string CheckRewinds(RewindBuffer &rewind_buffer, std::vector<SnapshotData> history)
+	{
+		JucyBoy::Snapshot snapshot;
+		for (size_t num_snapshots_back = 0; rewind_buffer.GetNumSnapshots() > 1; ++num_snapshots_back)
+		{
+			if (!rewind_buffer.Rewind(num_snapshots_back, snapshot)) return "nothing to rewind to";
+
+			const auto num_remaining = history.size() - std::min(num_snapshots_back, history.size() - 1);
+			history.resize(num_remaining);
+			if (rewind_buffer.GetNumSnapshots() != num_remaining) return "unexpected number of snapshots left: " + std::to_string(rewind_buffer.GetNumSnapshots());
+			if (GetSnapshotData(snapshot) != history.back()) return "snapshot " + std::to_string(num_remaining - 1) + " differs";
+		}
+		return{};
+	}
+
+	std::string RunRewinds(const std::string &rom_file_path)
+	{
+		JucyBoy jucy_boy{ rom_file_path };
+		RewindBuffer rewind_buffer{ 256 << 20, keyframe_interval };
+		std::vector<SnapshotData> history;
+
+		JucyBoy::Snapshot snapshot;
+		size_t num_frames_since_capture{ 0 };
+		jucy_boy.AddFrameSafePointListener([&]()
+		{
+			if (++num_frames_since_capture < capture_period) return;
+			num_frames_since_capture = 0;
+
+			jucy_boy.SaveSnapshot(snapshot);
+			rewind_buffer.Push(snapshot);
+			history.push_back(GetSnapshotData(snapshot));
+		});
+
+		// One machine cycle is 4 clock cycles
+		jucy_boy.RunMachineCycles(num_frames * (PPU::frame_duration_ / 4));
+
+		// Frames only start once the LCD is turned on
+		if (history.size() < num_frames / capture_period / 2) return "too few frame safe points: " + std::to_string(history.size() * capture_period);
+		if (rewind_buffer.GetNumSnapshots() != history.size()) return "snapshots dropped within budget";
+
+		const auto unbounded_memory_usage = rewind_buffer.GetMemoryUsage();
+		auto error = CheckRewinds(rewind_buffer, history);
+		if (!error.empty()) return error;
+
+		// A third of the memory used without a budget: the snapshots that fit must be the newest ones
+		RewindBuffer bounded_rewind_buffer{ unbounded_memory_usage / 3, keyframe_interval };
+		for (const auto &snapshot_data : history)
+		{
+			snapshot.Assign(snapshot_data.data(), snapshot_data.size());
+			bounded_rewind_buffer.Push(snapshot);
+			if (bounded_rewind_buffer.GetMemoryUsage() > bounded_rewind_buffer.GetMemoryBudget()) return "memory budget exceeded";
+		}
+
+		const auto num_kept = bounded_rewind_buffer.GetNumSnapshots();
+		if ((num_kept == history.size()) || (num_kept < keyframe_interval)) return "unexpected number of snapshots kept: " + std::to_string(num_kept);
+		history.erase(history.begin(), history.end() - num_kept);
+		return CheckRewinds(bounded_rewind_buffer, history);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		const TemporaryRomFile game_loop_rom{ "game_loop", BenchmarkRoms::MakeGameLoopRom() };
+
+		std::vector<std::pair<std::string, std::string>> workloads{ { "game_loop", game_loop_rom.GetPath() } };
+		for (int i = 1; i < argc; ++i)
+		{
+			workloads.emplace_back(argv[i], argv[i]);
+		}
+
+		size_t num_failures{ 0 };
+		for (const auto &workload : workloads)
+		{
+			const auto error = RunRewinds(workload.second);
+			std::printf("%s: %s\n", workload.first.c_str(), error.empty() ? "OK" : ("FAILED, " + error).c_str());
+			if (!error.empty()) ++num_failures;
+		}
+
+		return (num_failures == 0) ? 0 : 1;
+	}
+	catch (std::exception &e)
+	{
+		std::fprintf(stderr, "Error: %s\n", e.what());
+		return 1;
+	}
+}
@@ -0,0 +1,110 @@
+// Run-ahead test: running ahead must change which frames are presented, and nothing else.
+//
+// A first instance runs without run-ahead, a second one with it, both with the keys pressed halfway through (the game loop ROM does not read them,
+// but the joypad state is saved). Both must deliver bit-identical audio, call their frame safe point listeners as many times, and save identical states at the end.
+// Each frame presented with run-ahead must be the one completed as many frames later without it.
+// Runs the bundled game loop ROM (see BenchmarkCommon.h) plus any ROM files given in the command line.
+//
+// Usage: RunAheadTest [rom files...]
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "cereal/archives/binary.hpp"
+#include "cereal/types/array.hpp"
+#include "cereal/types/vector.hpp"
+#include "JucyBoy/JucyBoy.h"
+#include "../Benchmarks/BenchmarkCommon.h"
+
+namespace
+{
+	constexpr size_t num_frames{ 300 };
+	constexpr size_t num_run_ahead_frames{ 2 };
+
+	struct Run
+	{
+		std::vector<APU::SampleBatch> sample_batches;
+		std::vector<APU::OutputSample> output_samples;
+		std::vector<PPU::Framebuffer> presented_frames;
+		size_t num_frame_safe_points{ 0 };
+		std::string final_state;
+	};
+
+	Run RunFrames(const std::string &rom_file_path, size_t num_run_ahead_frames)
+	{
+		Run run;
+		JucyBoy jucy_boy{ rom_file_path };
+		jucy_boy.SetRunAheadFrames(num_run_ahead_frames);
+
+		jucy_boy.GetApu().AddListener([&run](const APU::SampleBatch *sample_batches, size_t num_sample_batches) { run.sample_batches.insert(run.sample_batches.end(), sample_batches, sample_batches + num_sample_batches); });
+		jucy_boy.GetApu().AddOutputListener([&run](const APU::OutputSample *output_samples, size_t num_output_samples) { run.output_samples.insert(run.output_samples.end(), output_samples, output_samples + num_output_samples); });
+		jucy_boy.AddFramePresentationListener([&]() { run.presented_frames.push_back(jucy_boy.GetPpu().GetFramebuffer()); });
+		jucy_boy.AddFrameSafePointListener([&run]() { ++run.num_frame_safe_points; });
+
+		// One machine cycle is 4 clock cycles
+		jucy_boy.RunMachineCycles((num_frames / 2) * (PPU::frame_duration_ / 4));
+		jucy_boy.GetJoypad().UpdatePressedKeys({ Joypad::Keys::A, Joypad::Keys::Right });
+		jucy_boy.RunMachineCycles((num_frames / 2) * (PPU::frame_duration_ / 4));
+
+		std::ostringstream state;
+		{
+			cereal::BinaryOutputArchive output_archive{ state };
+			output_archive(jucy_boy);
+		}
+		run.final_state = state.str();
+		return run;
+	}
+
+	// Returns an empty string on success, or a description of the first mismatch
+	std::string RunRunAhead(const std::string &rom_file_path)
+	{
+		const auto reference = RunFrames(rom_file_path, 0);
+		const auto run_ahead = RunFrames(rom_file_path, num_run_ahead_frames);
+
+		if (reference.sample_batches.empty()) return "no samples delivered";
+		if (reference.sample_batches != run_ahead.sample_batches) return "samples differ";
+		if (reference.output_samples != run_ahead.output_samples) return "output samples differ";
+		if (reference.num_frame_safe_points != run_ahead.num_frame_safe_points) return "frame safe points differ: " + std::to_string(run_ahead.num_frame_safe_points);
+		if (reference.final_state != run_ahead.final_state) return "final states differ";
+
+		// Frames only start once the LCD is turned on
+		if (reference.presented_frames.size() < num_frames / 2) return "too few frames presented: " + std::to_string(reference.presented_frames.size());
+		if (reference.presented_frames.size() != run_ahead.presented_frames.size()) return "frames presented differ: " + std::to_string(run_ahead.presented_frames.size());
+		for (size_t frame_index = 0; frame_index + num_run_ahead_frames < reference.presented_frames.size(); ++frame_index)
+		{
+			if (run_ahead.presented_frames[frame_index] != reference.presented_frames[frame_index + num_run_ahead_frames]) return "frame " + std::to_string(frame_index) + " not presented ahead";
+		}
+
+		return{};
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		const TemporaryRomFile game_loop_rom{ "game_loop", BenchmarkRoms::MakeGameLoopRom() };
+
+		std::vector<std::pair<std::string, std::string>> workloads{ { "game_loop", game_loop_rom.GetPath() } };
+		for (int i = 1; i < argc; ++i)
+		{
+			workloads.emplace_back(argv[i], argv[i]);
+		}
+
+		size_t num_failures{ 0 };
+		for (const auto &workload : workloads)
+		{
+			const auto error = RunRunAhead(workload.second);
+			std::printf("%s: %s\n", workload.first.c_str(), error.empty() ? "OK" : ("FAILED, " + error).c_str());
+			if (!error.empty()) ++num_failures;
+		}
+
+		return (num_failures == 0) ? 0 : 1;
+	}
+	catch (std::exception &e)
+	{
+		std::fprintf(stderr, "Error: %s\n", e.what());
+		return 1;
+	}
+}
@@ -0,0 +1,218 @@
+// Save state round-trip test: the emulation must continue exactly the same after loading a state as it did after saving it.
+//
+// A first instance runs for a while, saves its state and keeps running. A second instance loads that state and runs for as long.
+// Both must deliver bit-identical audio (raw samples and output samples) after the state was saved/loaded, and save identical states at the end.
+// States are round-tripped through binary save states, through in-memory snapshots (which must be laid out as save states),
+// and through save state files (written by a SaveStateWriter), which must also reject the states of other ROMs and corrupted files.
+// Runs the bundled game loop ROM (all 4 sound channels playing, see BenchmarkCommon.h) plus any ROM files given in the command line.
+//
+// Usage: SaveStateRoundTripTest [rom files...]
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "cereal/archives/binary.hpp"
+#include "cereal/types/array.hpp"
+#include "cereal/types/vector.hpp"
+#include "JucyBoy/JucyBoy.h"
+#include "JucyBoy/SaveStateFile.h"
+#include "../Benchmarks/BenchmarkCommon.h"
+
+namespace
+{
+	constexpr size_t num_frames_before_state{ 150 };
+	constexpr size_t num_frames_after_state{ 150 };
+
+	// Collects all samples delivered by the APU
+	class AudioCapture final
+	{
+	public:
+		AudioCapture(APU &apu)
+		{
+			apu.AddListener([this](const APU::SampleBatch *sample_batches, size_t num_sample_batches) { sample_batches_.insert(sample_batches_.end(), sample_batches, sample_batches + num_sample_batches); });
+			apu.AddOutputListener([this](const APU::OutputSample *output_samples, size_t num_output_samples) { output_samples_.insert(output_samples_.end(), output_samples, output_samples + num_output_samples); });
+		}
+
+		void Clear()
+		{
+			sample_batches_.clear();
+			output_samples_.clear();
+		}
+
+		const std::vector<APU::SampleBatch>& GetSampleBatches() const { return sample_batches_; }
+		const std::vector<APU::OutputSample>& GetOutputSamples() const { return output_samples_; }
+
+	private:
+		std::vector<APU::SampleBatch> sample_batches_;
+		std::vector<APU::OutputSample> output_samples_;
+	};
+
+	void RunFrames(JucyBoy &jucy_boy, size_t num_frames)
+	{
+		// One machine cycle is 4 clock cycles
+		jucy_boy.RunMachineCycles(num_frames * (PPU::frame_duration_ / 4));
+	}
+
+	std::string SaveState(JucyBoy &jucy_boy)
+	{
+		std::ostringstream state;
+		{
+			cereal::BinaryOutputArchive output_archive{ state };
+			output_archive(jucy_boy);
+		}
+		return state.str();
+	}
+
+	void LoadState(JucyBoy &jucy_boy, const std::string &state)
+	{
+		std::istringstream state_stream{ state };
+		cereal::BinaryInputArchive input_archive{ state_stream };
+		input_archive(jucy_boy);
+	}
+
+	// Returns an empty string on success
+	std::string RoundTripFile(const JucyBoy::Snapshot &snapshot, uint64_t rom_hash, JucyBoy::Snapshot &read_snapshot)
+	{
+		const auto file_path = (std::filesystem::temp_directory_path() / "jucyboy_test_state.jb1").string();
+
+		std::string write_error;
+		{SaveStateWriter writer{ [&write_error](const std::string&, const std::string &error) { write_error = error; } };
+		writer.Write(file_path, snapshot, rom_hash);
+		writer.WaitForPendingWrites(); }
+		if (!write_error.empty()) return "could not write file: " + write_error;
+
+		std::string error;
+		try
+		{
+			SaveStateFile::Read(file_path, rom_hash + 1, read_snapshot);
+			error = "state of another ROM not rejected";
+		}
+		catch (std::exception &) {}
+
+		if (error.empty())
+		{
+			// Flip a bit halfway through the file (within the PPU section, mostly literal bytes of the framebuffer and tile data)
+			std::fstream file{ file_path, std::ios::binary | std::ios::in | std::ios::out };
+			const auto position = static_cast<std::streamoff>(std::filesystem::file_size(file_path) / 2);
+			file.seekg(position);
+			const auto original_byte = static_cast<char>(file.get());
+			file.seekp(position);
+			file.put(static_cast<char>(original_byte ^ 0x01));
+			file.close();
+
+			try
+			{
+				SaveStateFile::Read(file_path, rom_hash, read_snapshot);
+				error = "corrupted file not rejected";
+			}
+			catch (std::exception &) {}
+
+			file.open(file_path, std::ios::binary | std::ios::in | std::ios::out);
+			file.seekp(position);
+			file.put(original_byte);
+			file.close();
+		}
+
+		if (error.empty())
+		{
+			try
+			{
+				SaveStateFile::Read(file_path, rom_hash, read_snapshot);
+			}
+			catch (std::exception &e)
+			{
+				error = std::string{ "could not read file: " } + e.what();
+			}
+		}
+
+		std::error_code error_code;
+		std::filesystem::remove(file_path, error_code);
+		return error;
+	}
+
+	enum class StateKind { SaveState, Snapshot, SaveStateFile };
+
+	// Returns an empty string on success, or a description of the first mismatch
+	std::string RunRoundTrip(const std::string &rom_file_path, StateKind state_kind)
+	{
+		JucyBoy original{ rom_file_path };
+		AudioCapture original_audio{ original.GetApu() };
+		RunFrames(original, num_frames_before_state);
+		const auto state = SaveState(original);
+		const auto snapshot = original.CreateSnapshot();
+		original_audio.Clear();
+		RunFrames(original, num_frames_after_state);
+
+		if (std::string(reinterpret_cast<const char*>(snapshot.GetData()), snapshot.GetSize()) != state) return "snapshot not laid out as the save state";
+
+		JucyBoy restored{ rom_file_path };
+		AudioCapture restored_audio{ restored.GetApu() };
+		if (state_kind == StateKind::SaveState)
+		{
+			LoadState(restored, state);
+		}
+		else if (state_kind == StateKind::Snapshot)
+		{
+			restored.LoadSnapshot(snapshot);
+		}
+		else
+		{
+			JucyBoy::Snapshot read_snapshot;
+			const auto error = RoundTripFile(snapshot, original.GetRomHash(), read_snapshot);
+			if (!error.empty()) return error;
+			if (std::string(reinterpret_cast<const char*>(read_snapshot.GetData()), read_snapshot.GetSize()) != state) return "save state file read back differs";
+			restored.LoadSnapshot(read_snapshot);
+		}
+		restored_audio.Clear();
+		RunFrames(restored, num_frames_after_state);
+
+		if (original_audio.GetSampleBatches().empty()) return "no samples delivered";
+		if (original_audio.GetSampleBatches() != restored_audio.GetSampleBatches())
+		{
+			return "samples differ (" + std::to_string(original_audio.GetSampleBatches().size()) + " vs " + std::to_string(restored_audio.GetSampleBatches().size()) + " delivered)";
+		}
+		if (original_audio.GetOutputSamples() != restored_audio.GetOutputSamples())
+		{
+			return "output samples differ (" + std::to_string(original_audio.GetOutputSamples().size()) + " vs " + std::to_string(restored_audio.GetOutputSamples().size()) + " delivered)";
+		}
+		if (SaveState(original) != SaveState(restored)) return "final states differ";
+
+		return{};
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	try
+	{
+		const TemporaryRomFile game_loop_rom{ "game_loop", BenchmarkRoms::MakeGameLoopRom() };
+
+		std::vector<std::pair<std::string, std::string>> workloads{ { "game_loop", game_loop_rom.GetPath() } };
+		for (int i = 1; i < argc; ++i)
+		{
+			workloads.emplace_back(argv[i], argv[i]);
+		}
+
+		size_t num_failures{ 0 };
+		for (const auto &workload : workloads)
+		{
+			for (const auto state_kind : { StateKind::SaveState, StateKind::Snapshot, StateKind::SaveStateFile })
+			{
+				const auto error = RunRoundTrip(workload.second, state_kind);
+				const auto name = workload.first + ((state_kind == StateKind::SaveState) ? " (save state)" : (state_kind == StateKind::Snapshot) ? " (snapshot)" : " (save state file)");
+				std::printf("%s: %s\n", name.c_str(), error.empty() ? "OK" : ("FAILED, " + error).c_str());
+				if (!error.empty()) ++num_failures;
+			}
+		}
+
+		return (num_failures == 0) ? 0 : 1;
+	}
+	catch (std::exception &e)
+	{
+		std::fprintf(stderr, "Error: %s\n", e.what());
+		return 1;
+	}
+}